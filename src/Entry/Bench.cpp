@@ -0,0 +1,513 @@
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IA/Compiled_Network.hpp"
+#include "IA/Gene_Pool.hpp"
+#include "IA/Network.hpp"
+#include "IA/Network_Arena.hpp"
+#include "IA/Population.hpp"
+#include "IA/Quantized_Network.hpp"
+#include "Profiler/Timer.hpp"
+#include "Random/Random.hpp"
+
+// A dataset of the experiments, every row starts with the bias input.
+struct Dataset {
+	const char* name;
+	size_t n_rows;
+	std::vector<float> inputs;
+	std::vector<float> targets;
+};
+
+Dataset xor_dataset() noexcept {
+	return { "Xor", 4, { 1, 0, 0,   1, 1, 0,   1, 0, 1,   1, 1, 1 }, { 0, 1, 1, 0 } };
+}
+
+Dataset f_dataset() noexcept {
+	Dataset d{ "F", 10, {}, {} };
+	for (size_t i = 0; i < d.n_rows; ++i) {
+		float x = i / (float)d.n_rows;
+		d.inputs.insert(d.inputs.end(), { 1, x, 0 });
+		d.targets.push_back(x * x);
+	}
+	return d;
+}
+
+// Same scoring as the experiments, without the rendering.
+Population evolve(const Dataset& d, Population pop, size_t generations) noexcept {
+	Network_Arena arena;
+	std::vector<float> outputs;
+
+	for (size_t gen = 0; gen < generations; ++gen) {
+		arena.build(pop.genomes);
+		outputs.resize(arena.size() * d.n_rows);
+		arena.compute(d.inputs.data(), d.n_rows, outputs.data());
+
+		for (size_t g = 0; g < pop.genomes.size(); ++g) {
+			float error = 0;
+			for (size_t i = 0; i < d.n_rows; ++i) error += std::abs(outputs[g * d.n_rows + i] - d.targets[i]);
+			pop.genomes[g].fitness = 1 / (error + 1);
+		}
+
+		pop.selection();
+		pop.reproduction();
+		pop.speciate();
+	}
+
+	return pop;
+}
+
+// The evolved genomes stay close to the initial ones, this stands in for a longer run.
+Population grow(Population pop, size_t n_mutations) noexcept {
+	auto rng = pcg32_seed(0, 0);
+	for (auto& x : pop.genomes) {
+		for (size_t i = 0; i < n_mutations; ++i) {
+			x.add_node_mutation(rng);
+			x.add_connection_mutation(rng);
+			x.add_connection_mutation(rng);
+		}
+		for (size_t i = x.n_inputs; i < x.node_genes.size(); ++i) x.activation_func_mutation(i, rng);
+	}
+	return pop;
+}
+
+// Per node activation dispatch against one kernel per group of the same layer and activation.
+void bench_grouping(const Dataset& d, const Population& pop, size_t n_rows) noexcept {
+	std::vector<Network> nets;
+	size_t n_slots = 0;
+	size_t n_groups = 0;
+	for (auto& x : pop.genomes) {
+		nets.push_back(Network::generate(x));
+		n_slots += nets.back().plan.order.size();
+		n_groups += nets.back().plan.groups.size();
+	}
+
+	// The dataset repeated up to n_rows.
+	std::vector<float> inputs;
+	for (size_t r = 0; r < n_rows; ++r) {
+		auto row = d.inputs.data() + (r % d.n_rows) * 3;
+		inputs.insert(inputs.end(), row, row + 3);
+	}
+	std::vector<float> per_node(nets.size() * n_rows);
+	std::vector<float> grouped(nets.size() * n_rows);
+
+	auto run = [&](bool group, std::vector<float>& out) {
+		double best = 1e9;
+		for (size_t rep = 0; rep < 10; ++rep) {
+			auto t1 = seconds();
+			for (size_t i = 0; i < nets.size(); ++i) {
+				nets[i].grouped = group;
+				nets[i].compute(inputs.data(), n_rows, out.data() + i * n_rows);
+			}
+			best = std::min(best, seconds() - t1);
+		}
+		return best;
+	};
+
+	double t_node = run(false, per_node);
+	double t_group = run(true, grouped);
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < per_node.size(); ++i) mismatches += per_node[i] != grouped[i];
+
+	printf(
+		"%s, %zu networks, %.2f nodes and %.2f groups each, %zu rows:\n"
+		"  per node %8.1f ns/network\n"
+		"  grouped  %8.1f ns/network (x%.2f), %zu mismatches\n",
+		d.name,
+		nets.size(),
+		1.0 * n_slots / nets.size(),
+		1.0 * n_groups / nets.size(),
+		n_rows,
+		t_node * 1e9 / nets.size(),
+		t_group * 1e9 / nets.size(),
+		t_node / t_group,
+		mismatches
+	);
+}
+
+// Float against fixed point evaluation, calibrated on the dataset itself.
+void bench_quantized(const Dataset& d, const Population& pop, size_t n_rows) noexcept {
+	std::vector<float> inputs;
+	for (size_t r = 0; r < n_rows; ++r) {
+		auto row = d.inputs.data() + (r % d.n_rows) * 3;
+		inputs.insert(inputs.end(), row, row + 3);
+	}
+
+	std::vector<Network> nets;
+	std::vector<Quantized_Network> quantized;
+	for (auto& x : pop.genomes) {
+		nets.push_back(Network::generate(x));
+		nets.back().fast_activations = true;
+		quantized.push_back(Quantized_Network::quantize(nets.back(), d.inputs.data(), d.n_rows));
+	}
+
+	std::vector<float> out(n_rows);
+	auto time = [&](auto& xs) {
+		double best = 1e9;
+		for (size_t rep = 0; rep < 10; ++rep) {
+			auto t1 = seconds();
+			for (auto& x : xs) x.compute(inputs.data(), n_rows, out.data());
+			best = std::min(best, seconds() - t1);
+		}
+		return best;
+	};
+
+	double t_float = time(nets);
+	double t_fixed = time(quantized);
+
+	Quantized_Network::Report worst;
+	double mean_error = 0;
+	double agreement = 0;
+	for (size_t i = 0; i < nets.size(); ++i) {
+		auto report = quantized[i].compare(nets[i], inputs.data(), n_rows);
+		if (report.max_error > worst.max_error) worst = report;
+		mean_error += report.mean_error;
+		agreement += report.agreement;
+	}
+
+	printf(
+		"%s, %zu rows: float %.1f ns/network, int16/int8 %.1f ns/network (x%.2f)\n"
+		"  mean error %g, worst network max error %g, %.2f%% same decisions\n",
+		d.name,
+		n_rows,
+		t_float * 1e9 / nets.size(),
+		t_fixed * 1e9 / nets.size(),
+		t_float / t_fixed,
+		mean_error / nets.size(),
+		worst.max_error,
+		100 * agreement / nets.size()
+	);
+}
+
+// Compiling takes a while, only the few largest genomes are built.
+void bench_compiled(const Dataset& d, const Population& pop, size_t n_rows, size_t n_networks) noexcept {
+	std::vector<float> inputs;
+	for (size_t r = 0; r < n_rows; ++r) {
+		auto row = d.inputs.data() + (r % d.n_rows) * 3;
+		inputs.insert(inputs.end(), row, row + 3);
+	}
+
+	std::vector<const Genome*> largest;
+	for (auto& x : pop.genomes) largest.push_back(&x);
+	std::sort(largest.begin(), largest.end(), [](auto a, auto b) {
+		return a->connection_genes.size() > b->connection_genes.size();
+	});
+	largest.resize(std::min(largest.size(), n_networks));
+
+	auto t1 = seconds();
+	std::vector<Network> nets;
+	std::vector<Compiled_Network> compiled;
+	for (auto& x : largest) {
+		nets.push_back(Network::generate(*x));
+		compiled.push_back(Compiled_Network::compile(*x));
+	}
+	double t_compile = seconds() - t1;
+
+	size_t n_compiled = 0;
+	for (auto& x : compiled) n_compiled += x.compiled();
+	if (n_compiled == 0) {
+		printf("%s: no compiler found, compiled networks skipped\n", d.name);
+		return;
+	}
+
+	std::vector<float> out(n_rows);
+	std::vector<float> expected(n_rows);
+	auto time = [&](auto& xs) {
+		double best = 1e9;
+		for (size_t rep = 0; rep < 10; ++rep) {
+			auto t1 = seconds();
+			for (auto& x : xs) x.compute(inputs.data(), n_rows, out.data());
+			best = std::min(best, seconds() - t1);
+		}
+		return best;
+	};
+
+	double t_plan = time(nets);
+	double t_code = time(compiled);
+
+	double max_error = 0;
+	for (size_t i = 0; i < nets.size(); ++i) {
+		nets[i].compute(inputs.data(), n_rows, expected.data());
+		compiled[i].compute(inputs.data(), n_rows, out.data());
+		for (size_t r = 0; r < n_rows; ++r)
+			max_error = std::max(max_error, (double)std::abs(out[r] - expected[r]));
+	}
+
+	printf(
+		"%s, %zu rows: %zu/%zu compiled in %fs, plan %.1f ns/network, native %.1f ns/network (x%.2f)"
+		", max error %g\n",
+		d.name,
+		n_rows,
+		n_compiled,
+		compiled.size(),
+		t_compile,
+		t_plan * 1e9 / nets.size(),
+		t_code * 1e9 / nets.size(),
+		t_plan / t_code,
+		max_error
+	);
+}
+
+// The crossover as it was before connection genes were kept sorted: parent2 is scanned from the
+// start for every gene of parent1.
+Genome crossover_scan(const Genome& parent1, const Genome& parent2, pcg32_random_t& rng) noexcept {
+	Genome offspring;
+	offspring.n_inputs = parent1.n_inputs;
+	offspring.n_outputs = parent1.n_outputs;
+	offspring.connection_genes.reserve(parent1.connection_genes.size());
+	offspring.node_genes = parent1.node_genes;
+
+	for (auto x : parent1.connection_genes) {
+		const ConnectionGene* other = nullptr;
+		for (auto& y : parent2.connection_genes) {
+			if (x.innov < y.innov) break;
+			if (x.innov == y.innov) {
+				other = &y;
+				x.w = (x.w + y.w) / 2;
+				break;
+			}
+		}
+
+		if (other) offspring.connection_genes.push_back(randomf(rng) > .5 ? x : *other);
+		else       offspring.connection_genes.push_back(x);
+	}
+	return offspring;
+}
+
+// Crossover of every genome with the next, both genomes sharing most of their genes.
+void bench_crossover(const Population& pop, size_t n_mutations) noexcept {
+	std::vector<Genome> parents;
+	parents.reserve(pop.genomes.size());
+	for (size_t i = 0; i < std::min((size_t)64, pop.genomes.size()); ++i) parents.push_back(pop.genomes[i]);
+
+	// Half of the mutations happen on a common ancestor.
+	auto rng = pcg32_seed(0, 0);
+	Genome ancestor = parents[0];
+	for (size_t i = 0; i < n_mutations / 2; ++i) {
+		ancestor.add_node_mutation(rng);
+		ancestor.add_connection_mutation(rng);
+	}
+	for (auto& x : parents) {
+		x = ancestor;
+		for (size_t i = 0; i < n_mutations / 2; ++i) {
+			x.add_node_mutation(rng);
+			x.add_connection_mutation(rng);
+		}
+	}
+
+	size_t n_genes = 0;
+	for (auto& x : parents) n_genes += x.connection_genes.size();
+
+	auto time = [&](auto crossover) {
+		double best = 1e9;
+		size_t checksum = 0;
+		for (size_t rep = 0; rep < 5; ++rep) {
+			auto t1 = seconds();
+			for (size_t i = 0; i + 1 < parents.size(); ++i) {
+				auto child = crossover(parents[i], parents[i + 1], rng);
+				checksum += child.connection_genes.size() + child.connection_genes.back().innov;
+			}
+			best = std::min(best, seconds() - t1);
+		}
+		return std::pair{ best, checksum };
+	};
+
+	auto [t_scan, scan_sum] = time(crossover_scan);
+	auto [t_merge, merge_sum] = time([](const Genome& a, const Genome& b, pcg32_random_t& rng) {
+		return Genome::crossover(a, b, rng);
+	});
+
+	printf(
+		"Crossover, %zu genomes of %.0f genes: scan %.1f us, merge %.1f us (x%.1f)%s\n",
+		parents.size(),
+		n_genes / (double)parents.size(),
+		t_scan * 1e6 / (parents.size() - 1),
+		t_merge * 1e6 / (parents.size() - 1),
+		t_scan / t_merge,
+		scan_sum == merge_sum ? "" : ", different offsprings"
+	);
+}
+
+bool same_genes(const Genome& a, const Genome& b) noexcept {
+	if (a.connection_genes.size() != b.connection_genes.size()) return false;
+	if (a.node_genes.size() != b.node_genes.size()) return false;
+
+	for (size_t i = 0; i < a.connection_genes.size(); ++i) {
+		auto& x = a.connection_genes[i];
+		auto& y = b.connection_genes[i];
+		if (x.in != y.in || x.out != y.out || x.innov != y.innov) return false;
+		if (x.w != y.w || x.enabled != y.enabled) return false;
+	}
+	for (size_t i = 0; i < a.node_genes.size(); ++i) {
+		auto& x = a.node_genes[i];
+		auto& y = b.node_genes[i];
+		if (x.kind != y.kind || x.func != y.func) return false;
+	}
+	return true;
+}
+
+// One generation of reproduction and network building over the genomes against the gene pool,
+// single threaded. check_threads compares them with several threads.
+void bench_gene_pool(const Dataset& d, Population pop) noexcept {
+	pop.n_threads = 1;
+	pop.selection();
+
+	std::vector<float> adjusted;
+	for (auto& x : pop.genomes) adjusted.push_back(x.adjusted_fitness);
+
+	auto next_innovation = ConnectionGene::Innovations.next.load();
+	auto n_reproductions = pop.n_reproductions;
+	auto by_pool = pop;
+	double t_reproduction = 1e9;
+	for (size_t rep = 0; rep < 10; ++rep) {
+		auto copy = pop;
+		ConnectionGene::Innovations.next = next_innovation;
+		auto t1 = seconds();
+		copy.reproduction();
+		t_reproduction = std::min(t_reproduction, seconds() - t1);
+		if (rep == 9) pop = std::move(copy);
+	}
+
+	Gene_Pool parents;
+	Gene_Pool offsprings;
+	double t_pack = 1e9;
+	double t_breed = 1e9;
+	for (size_t rep = 0; rep < 10; ++rep) {
+		auto t1 = seconds();
+		parents.build(by_pool.genomes, by_pool.n_threads);
+		t_pack = std::min(t_pack, seconds() - t1);
+
+		ConnectionGene::Innovations.next = next_innovation;
+		by_pool.n_reproductions = n_reproductions;
+		t1 = seconds();
+		by_pool.breed(parents, adjusted.data(), offsprings);
+		t_breed = std::min(t_breed, seconds() - t1);
+	}
+
+	size_t n_parents = parents.size();
+	std::vector<Genome> children(pop.genomes.begin() + n_parents, pop.genomes.end());
+	size_t n_different = 0;
+	Genome unpacked;
+	for (size_t i = 0; i < children.size(); ++i) {
+		offsprings.unpack(i, unpacked);
+		n_different += !same_genes(unpacked, children[i]);
+	}
+
+	Network_Arena arena;
+	auto t1 = seconds();
+	arena.build(children);
+	double t_arena_genomes = seconds() - t1;
+	t1 = seconds();
+	arena.build(offsprings);
+	double t_arena_pool = seconds() - t1;
+
+	size_t pool_bytes = sizeof(uint32_t) * 3 + sizeof(float);
+	printf(
+		"%s, gene pool of %zu parents, %zu + 1/8 bytes a gene against %zu: reproduction %.2f ms, "
+		"pack %.2f ms + breed %.2f ms, arena from genomes %.2f ms, from pool %.2f ms%s\n",
+		d.name,
+		n_parents,
+		pool_bytes,
+		sizeof(ConnectionGene),
+		t_reproduction * 1e3,
+		t_pack * 1e3,
+		t_breed * 1e3,
+		t_arena_genomes * 1e3,
+		t_arena_pool * 1e3,
+		n_different ? ", different offsprings" : ""
+	);
+}
+
+// The same seed with one thread and with several, the structural mutations of the
+// threads must not race for their innovation numbers.
+void check_threads(const Dataset& d, size_t population_size, size_t generations) noexcept {
+	auto run = [&](size_t n_threads) {
+		ConnectionGene::Innovations.next = 0;
+		ConnectionGene::Innovations.new_generation();
+
+		// Plenty of structural mutations in many batches.
+		auto pop = Population::generate(population_size, 3, 1);
+		pop.n_threads = n_threads;
+		pop.mutation_add_node = 0.2f;
+		pop.mutation_add_lstm = 0.05f;
+		pop.mutation_add_connection = 0.3f;
+		return evolve(d, std::move(pop), generations);
+	};
+	size_t n_threads = std::max(4u, std::thread::hardware_concurrency());
+	auto single = run(1);
+	auto all = run(n_threads);
+
+	size_t n_different = single.genomes.size() != all.genomes.size();
+	for (size_t i = 0; !n_different && i < single.genomes.size(); ++i)
+		n_different += !same_genes(single.genomes[i], all.genomes[i]);
+
+	// One more generation bred from the gene pool with several threads.
+	single.selection();
+	std::vector<float> adjusted;
+	for (auto& x : single.genomes) adjusted.push_back(x.adjusted_fitness);
+
+	auto by_pool = single;
+	by_pool.n_threads = n_threads;
+	Gene_Pool parents;
+	Gene_Pool offsprings;
+	parents.build(by_pool.genomes, n_threads);
+
+	auto next_innovation = ConnectionGene::Innovations.next.load();
+	single.reproduction();
+	ConnectionGene::Innovations.next = next_innovation;
+	by_pool.breed(parents, adjusted.data(), offsprings);
+
+	size_t n_parents = parents.size();
+	size_t n_bred_different = offsprings.size() + n_parents != single.genomes.size();
+	Genome unpacked;
+	for (size_t i = 0; !n_bred_different && i < offsprings.size(); ++i) {
+		offsprings.unpack(i, unpacked);
+		n_bred_different += !same_genes(unpacked, single.genomes[n_parents + i]);
+	}
+
+	printf(
+		"%s, %zu generations with 1 and %zu threads: %s, bred from the gene pool: %s\n",
+		d.name,
+		generations,
+		n_threads,
+		n_different ? "different genomes" : "same genomes",
+		n_bred_different ? "different genomes" : "same genomes"
+	);
+}
+
+// Usage: Bench [population = 1000] [generations = 100]
+int main(int argc, char** argv) {
+	size_t population_size = argc > 1 ? std::stoull(argv[1]) : 1000;
+	size_t generations = argc > 2 ? std::stoull(argv[2]) : 100;
+
+	for (auto& d : { xor_dataset(), f_dataset() }) {
+		auto t1 = seconds();
+		auto pop = evolve(d, Population::generate(population_size, 3, 1), generations);
+		printf("%s: evolved %zu generations in %fs\n", d.name, generations, seconds() - t1);
+
+		bench_grouping(d, pop, d.n_rows);
+		bench_grouping(d, pop, Network::Batch_Tile);
+
+		auto grown = grow(pop, 20);
+		printf("%s, grown by 20 node and 40 connection mutations:\n", d.name);
+		bench_grouping(d, grown, d.n_rows);
+		bench_grouping(d, grown, Network::Batch_Tile);
+
+		bench_quantized(d, grown, d.n_rows);
+		bench_quantized(d, grown, Network::Batch_Tile);
+		bench_compiled(d, grown, Network::Batch_Tile, 8);
+		bench_gene_pool(d, grown);
+	}
+
+	check_threads(xor_dataset(), 10 * population_size, 10);
+
+	auto pop = Population::generate(64, 3, 1);
+	bench_crossover(pop, 200);
+	bench_crossover(pop, 2000);
+
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 
 #include "poker.hpp"
+#include "Tournament.hpp"
 #include "Profiler/Timer.hpp"
 
 #include "IA/Population.hpp"
@@ -35,6 +36,16 @@ double game() {
 	return t2 - t1;
 }
 
+Tournament::Result tournament(size_t n_games) {
+	Tournament t;
+	t.n_games = n_games;
+	t.seed = (uint64_t)seconds();
+
+	auto result = t.run();
+	result.print();
+	return result;
+}
+
 
 void test_genome() {
 }
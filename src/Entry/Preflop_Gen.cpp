@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <string>
+
+#include "Preflop.hpp"
+#include "Profiler/Timer.hpp"
+
+// Usage: Preflop_Gen [output = preflop.bin] [samples = 20000] [max opponents = 8] [seed = 0]
+int main(int argc, char** argv) {
+	std::filesystem::path path = argc > 1 ? argv[1] : "preflop.bin";
+	size_t samples = argc > 2 ? std::stoull(argv[2]) : 20'000;
+	size_t max_opponents = argc > 3 ? std::stoull(argv[3]) : 8;
+	uint64_t seed = argc > 4 ? std::stoull(argv[4]) : 0;
+
+	printf(
+		"Generating %s, %zu samples per matchup, up to %zu opponents.\n",
+		path.string().c_str(),
+		samples,
+		max_opponents
+	);
+
+	auto t1 = seconds();
+	if (!Preflop_Table::generate(path, samples, max_opponents, seed)) {
+		fprintf(stderr, "Could not write %s\n", path.string().c_str());
+		return 1;
+	}
+	auto t2 = seconds();
+
+	Preflop_Table table;
+	if (!table.load(path)) {
+		fprintf(stderr, "Could not load back %s\n", path.string().c_str());
+		return 1;
+	}
+
+	printf("Done in %fs.\n", t2 - t1);
+	return 0;
+}
@@ -0,0 +1,289 @@
+#include "Equity.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "Random/Random.hpp"
+
+namespace {
+	// Running totals, only integers so merging them does not depend on the order.
+	struct Tally {
+		size_t lose{ 0 };
+		// split[n] counts the showdowns where the pot is shared between n players, split[1] are wins.
+		std::array<size_t, Equity::Max_Opponents + 2> split{};
+
+		void add(bool lost, size_t n_tied) noexcept {
+			if (lost) lose++;
+			else      split[1 + n_tied]++;
+		}
+
+		void merge(const Tally& other) noexcept {
+			lose += other.lose;
+			for (size_t i = 0; i < split.size(); ++i) split[i] += other.split[i];
+		}
+
+		Equity::Result result() const noexcept {
+			Equity::Result r;
+			r.samples = lose;
+			for (auto x : split) r.samples += x;
+			if (!r.samples) return r;
+
+			double n = (double)r.samples;
+			double share = 0;
+			double share_squared = 0;
+			for (size_t i = 1; i < split.size(); ++i) {
+				share += 1.0 * split[i] / i;
+				share_squared += 1.0 * split[i] / (i * i);
+				if (i > 1) r.tie += split[i];
+			}
+
+			r.win = split[1] / n;
+			r.tie /= n;
+			r.lose = lose / n;
+			r.share = share / n;
+
+			double variance = std::max(0.0, share_squared / n - r.share * r.share);
+			r.confidence = 1.96 * std::sqrt(variance / n);
+			return r;
+		}
+	};
+
+	size_t mul_saturate(size_t a, size_t b) noexcept {
+		if (a && b > SIZE_MAX / a) return SIZE_MAX;
+		return a * b;
+	}
+
+	size_t binomial(size_t n, size_t k) noexcept {
+		if (k > n) return 0;
+		size_t r = 1;
+		for (size_t i = 0; i < k; ++i) {
+			if (r > SIZE_MAX / (n - i)) return SIZE_MAX;
+			r = r * (n - i) / (i + 1);
+		}
+		return r;
+	}
+
+	// Number of ways to deal hole cards to n_opponents players out of n_free cards.
+	size_t hole_ways(size_t n_free, size_t n_opponents) noexcept {
+		size_t r = 1;
+		for (size_t i = 0; i < n_opponents; ++i) r = mul_saturate(r, binomial(n_free - 2 * i, 2));
+		return r;
+	}
+
+	size_t worker_count(size_t n_threads, size_t n_items) noexcept {
+		size_t threads = n_threads ? n_threads : std::max(1u, std::thread::hardware_concurrency());
+		return std::max((size_t)1, std::min(threads, n_items));
+	}
+
+	template<typename F>
+	void run_workers(size_t threads, F&& work) noexcept {
+		std::vector<std::thread> workers;
+		workers.reserve(threads - 1);
+		for (size_t i = 1; i < threads; ++i) workers.emplace_back(work, i);
+		work(0);
+		for (auto& x : workers) x.join();
+	}
+
+	// Everything that stays the same between two showdowns.
+	struct Table {
+		CardSet mine;
+		CardSet known_board;
+		std::array<CardSet, Equity::Max_Opponents> known;
+		size_t n_known{ 0 };
+		size_t n_unknown{ 0 };
+
+		// Cards that are neither on the board nor in a known hand.
+		std::array<Card, CardSet::N_Cards> remaining;
+		size_t n_remaining{ 0 };
+
+		size_t to_draw{ 0 };
+
+		Table(const Equity& equity) noexcept {
+			assert(equity.n_board <= equity.board.size());
+			assert(equity.n_opponents <= Equity::Max_Opponents);
+			assert(equity.n_known_opponents <= equity.n_opponents);
+
+			mine = CardSet::from(equity.hole);
+			known_board = CardSet::from(equity.board.data(), equity.n_board);
+
+			n_known = equity.n_known_opponents;
+			n_unknown = equity.n_opponents - n_known;
+			auto taken = mine | known_board;
+			for (size_t i = 0; i < n_known; ++i) {
+				known[i] = CardSet::from(equity.known_opponents[i]);
+				taken |= known[i];
+			}
+
+			n_remaining = (CardSet::full() - taken).to_cards(remaining.data());
+			to_draw = equity.board.size() - equity.n_board;
+		}
+	};
+
+	// Depth first walk over every board completion then every hole cards of the unknown opponents.
+	// As soon as an opponent beats us the whole subtree is a loss and is counted at once.
+	struct Enumeration {
+		const Table& t;
+		Tally tally;
+
+		Enumeration(const Table& t) noexcept : t(t) {}
+
+		void boards(CardSet board, CardSet used, size_t start, size_t left) noexcept {
+			if (left == 0) return showdown(board, used);
+
+			for (size_t a = start; a + left <= t.n_remaining; ++a) {
+				auto x = CardSet::from(t.remaining[a]);
+				boards(board | x, used | x, a + 1, left - 1);
+			}
+		}
+
+		void showdown(CardSet board, CardSet used) noexcept {
+			auto me = Combo::evaluate(board | t.mine);
+
+			size_t n_tied = 0;
+			for (size_t i = 0; i < t.n_known; ++i) {
+				auto combo = Combo::evaluate(board | t.known[i]);
+				if (combo > me) {
+					tally.lose += hole_ways(t.n_remaining - used.size(), t.n_unknown);
+					return;
+				}
+				if (combo == me) n_tied++;
+			}
+
+			opponents(board, used, me, 0, n_tied);
+		}
+
+		void opponents(CardSet board, CardSet used, Combo me, size_t i, size_t n_tied) noexcept {
+			if (i == t.n_unknown) return tally.add(false, n_tied);
+
+			for (size_t a = 0; a < t.n_remaining; ++a) {
+				auto x = CardSet::from(t.remaining[a]);
+				if ((used & x).bits) continue;
+
+				for (size_t b = a + 1; b < t.n_remaining; ++b) {
+					auto y = CardSet::from(t.remaining[b]);
+					if ((used & y).bits) continue;
+
+					auto now_used = used | x | y;
+					auto combo = Combo::evaluate(board | x | y);
+					if (combo > me) {
+						tally.lose += hole_ways(t.n_remaining - now_used.size(), t.n_unknown - i - 1);
+						continue;
+					}
+
+					opponents(board, now_used, me, i + 1, n_tied + (combo == me ? 1 : 0));
+				}
+			}
+		}
+	};
+}
+
+size_t Equity::exact_size() const noexcept {
+	Table t(*this);
+	return mul_saturate(
+		binomial(t.n_remaining, t.to_draw), hole_ways(t.n_remaining - t.to_draw, t.n_unknown)
+	);
+}
+
+Equity::Result Equity::run() const noexcept {
+	switch (mode) {
+	case Mode::Exact: return exact();
+	case Mode::Monte_Carlo: return monte_carlo();
+	default: return exact_size() <= exact_limit ? exact() : monte_carlo();
+	}
+}
+
+Equity::Result Equity::exact() const noexcept {
+	Table t(*this);
+
+	// The work is split on the first board card. With a complete board there is at most a few
+	// millions showdowns left, so we keep it on one thread.
+	size_t n_items = t.to_draw ? t.n_remaining - t.to_draw + 1 : 1;
+	size_t threads = worker_count(n_threads, n_items);
+
+	std::vector<Tally> tallies(threads);
+	std::atomic<size_t> next_item = 0;
+
+	run_workers(threads, [&](size_t worker) {
+		Enumeration e(t);
+
+		if (!t.to_draw) {
+			if (next_item.fetch_add(1) == 0) e.showdown(t.known_board, {});
+		}
+		else for (size_t a; (a = next_item.fetch_add(1)) < n_items;) {
+			auto x = CardSet::from(t.remaining[a]);
+			e.boards(t.known_board | x, x, a + 1, t.to_draw - 1);
+		}
+
+		tallies[worker] = e.tally;
+	});
+
+	Tally total;
+	for (auto& x : tallies) total.merge(x);
+
+	auto result = total.result();
+	result.exact = true;
+	result.confidence = 0;
+	return result;
+}
+
+Equity::Result Equity::monte_carlo() const noexcept {
+	Table t(*this);
+	assert(t.to_draw + 2 * t.n_unknown <= t.n_remaining);
+
+	size_t threads = worker_count(n_threads, n_samples);
+	std::vector<Tally> tallies(threads);
+
+	run_workers(threads, [&](size_t worker) {
+		auto rng = pcg32_seed(seed, worker);
+		auto cards = t.remaining;
+		Tally tally;
+
+		size_t begin = n_samples * worker / threads;
+		size_t end = n_samples * (worker + 1) / threads;
+
+		// Partial Fisher-Yates, the first k cards of `cards` are a uniform draw without replacement.
+		auto draw = [&](size_t i) {
+			size_t select = i + random(rng, (uint32_t)(t.n_remaining - i));
+			std::swap(cards[i], cards[select]);
+			return cards[i];
+		};
+
+		for (size_t s = begin; s < end; ++s) {
+			size_t dealt = 0;
+
+			auto board = t.known_board;
+			for (size_t i = 0; i < t.to_draw; ++i) board.insert(draw(dealt++));
+
+			auto me = Combo::evaluate(board | t.mine);
+
+			size_t n_tied = 0;
+			bool lost = false;
+			for (size_t i = 0; i < t.n_known && !lost; ++i) {
+				auto combo = Combo::evaluate(board | t.known[i]);
+				if (combo > me) lost = true;
+				else if (combo == me) n_tied++;
+			}
+			for (size_t i = 0; i < t.n_unknown && !lost; ++i) {
+				auto other = board;
+				other.insert(draw(dealt++));
+				other.insert(draw(dealt++));
+
+				auto combo = Combo::evaluate(other);
+				if (combo > me) lost = true;
+				else if (combo == me) n_tied++;
+			}
+
+			tally.add(lost, n_tied);
+		}
+
+		tallies[worker] = tally;
+	});
+
+	Tally total;
+	for (auto& x : tallies) total.merge(x);
+	return total.result();
+}
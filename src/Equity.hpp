@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <stdint.h>
+
+#include "poker.hpp"
+
+// Equity of known hole cards on a partial board against opponents, some of them possibly with
+// known cards, the others holding random cards.
+struct Equity {
+	static constexpr size_t Max_Opponents = 9;
+
+	struct Result {
+		double win{ 0 };
+		double tie{ 0 };
+		double lose{ 0 };
+
+		// Expected share of the pot, a tie with n players is worth 1/n.
+		double share{ 0 };
+		// Half width of the 95% confidence interval around share, 0 when exact.
+		double confidence{ 0 };
+
+		size_t samples{ 0 };
+		bool exact{ false };
+	};
+
+	enum class Mode {
+		Auto = 0,
+		Exact,
+		Monte_Carlo,
+		Count
+	};
+
+	std::array<Card, 2> hole;
+	std::array<Card, 5> board;
+	size_t n_board{ 0 };
+
+	size_t n_opponents{ 1 };
+	// The first n_known_opponents opponents hold these cards, the others are dealt at random.
+	std::array<std::array<Card, 2>, Max_Opponents> known_opponents;
+	size_t n_known_opponents{ 0 };
+
+	Mode mode{ Mode::Auto };
+	// In Auto mode, above this number of showdowns we sample instead of enumerating.
+	size_t exact_limit{ 5'000'000 };
+
+	size_t n_samples{ 100'000 };
+	// 0 means one per hardware thread.
+	size_t n_threads{ 0 };
+	uint64_t seed{ 0 };
+
+	// Number of showdowns an exact enumeration goes through, saturates at SIZE_MAX.
+	size_t exact_size() const noexcept;
+
+	Result run() const noexcept;
+	Result monte_carlo() const noexcept;
+	// Enumerates every board completion and every hole cards of the unknown opponents. The
+	// result is bit reproducible whatever the number of threads.
+	Result exact() const noexcept;
+};
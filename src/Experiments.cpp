@@ -63,7 +63,16 @@ void render_genome(Genome& genome) noexcept {
 	}
 }
 
+Exp::~Exp() noexcept {
+	if (champion_build.valid()) champion_build.wait();
+}
+
 void Exp::launch() noexcept {
+	// The champion of the previous population is dropped, a build still running is waited for.
+	if (champion_build.valid()) champion_build.wait();
+	champion_build = {};
+	champion = {};
+
 	pop = Population::generate(pop.population_size, 3, 1);
 	generation_number = 0;
 	bests.clear();
@@ -84,6 +93,7 @@ void Exp::launch() noexcept {
 }
 
 void Exp::render(ImGui_State& state) noexcept {
+	std::scoped_lock lock(mutex);
 	ImGui::Begin(name.c_str());
 	defer { ImGui::End(); };
 	render_stats(state);
@@ -138,6 +148,34 @@ void Exp::render_stats(ImGui_State& imgui_state) noexcept {
 
 	ImGui::Text("Species: %zu", pop.species.size());
 
+	bool built =
+		champion_build.valid() &&
+		champion_build.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	if (built) {
+		champion = champion_build.get();
+		champion_generation = champion_build_generation;
+	}
+
+	if (champion_build.valid()) {
+		ImGui::Text("Compiling the champion...");
+	} else {
+		if (ImGui::Button("Compile champion") && !bests.empty()) {
+			// The thread only owns its copy of the genome.
+			champion_build_generation = generation_number;
+			champion_build = std::async(std::launch::async, [genome = bests.back()] {
+				return Compiled_Network::compile(genome);
+			});
+		}
+		if (champion.network.n_outputs > 0) {
+			ImGui::SameLine();
+			ImGui::Text(
+				"Generation %zu champion: %s",
+				champion_generation,
+				champion.compiled() ? "native" : "interpreted, the compilation failed"
+			);
+		}
+	}
+
 	if (ImGui::CollapsingHeader("Genome") && !bests.empty()) {
 		ImGui::BeginChild("Genomes");
 		defer { ImGui::EndChild(); };
@@ -149,6 +187,7 @@ void Exp::render_params(ImGui_State& imgui_state) noexcept {
 	ImGui::SliderFloat("Specie Treshold", &pop.specie_treshold, 0, 10);
 	ImGui::SliderFloat("To kill", &pop.to_kill, 0, 1);
 	ImGui::SliderFloat("Add node", &pop.mutation_add_node, 0, 1);
+	ImGui::SliderFloat("Add LSTM", &pop.mutation_add_lstm, 0, 1);
 	ImGui::SliderFloat("Del node", &pop.mutation_del_node, 0, 1);
 	ImGui::SliderFloat("Add Connection", &pop.mutation_add_connection, 0, 1);
 	ImGui::SliderFloat("Del Connection", &pop.mutation_del_connection, 0, 1);
@@ -169,19 +208,20 @@ void Xor_Exp::epoch() noexcept {
 	fitnesses.reserve(pop.population_size);
 	fitnesses.clear();
 
-	for (auto& x : pop.genomes) {
+	// The bias input followed by the two operands.
+	constexpr size_t N_Rows = 4;
+	constexpr float inputs[N_Rows * 3] = { 1, 0, 0,   1, 1, 0,   1, 0, 1,   1, 1, 1 };
+	constexpr float targets[N_Rows] = { 0, 1, 1, 0 };
+
+	arena.build(pop.genomes);
+	outputs.resize(arena.size() * N_Rows);
+	arena.compute(inputs, N_Rows, outputs.data());
+
+	for (size_t g = 0; g < pop.genomes.size(); ++g) {
+		auto& x = pop.genomes[g];
 		x.fitness = 0;
-		auto net = Network::generate(x);
-
-		float a = 0;
-		a = 0 - net.compute({1, 0, 0}).front();
-		x.fitness += std::abs(a);
-		a = 1 - net.compute({1, 1, 0}).front();
-		x.fitness += std::abs(a);
-		a = 1 - net.compute({1, 0, 1}).front();
-		x.fitness += std::abs(a);
-		a = 0 - net.compute({1, 1, 1}).front();
-		x.fitness += std::abs(a);
+
+		for (size_t i = 0; i < N_Rows; ++i) x.fitness += std::abs(targets[i] - outputs[g * N_Rows + i]);
 		x.fitness = 4 - x.fitness;
 
 		avg += x.fitness;
@@ -194,11 +234,8 @@ void Xor_Exp::epoch() noexcept {
 	avg /= pop.genomes.size();
 
 	{
-		auto net = Network::generate(*best);
-		best_results[0] = net.compute({1, 0, 0}).front();
-		best_results[1] = net.compute({1, 1, 0}).front();
-		best_results[2] = net.compute({1, 0, 1}).front();
-		best_results[3] = net.compute({1, 1, 1}).front();
+		size_t g = best - pop.genomes.data();
+		std::copy_n(outputs.data() + g * N_Rows, N_Rows, best_results.data());
 	}
 
 	mutex.lock();
@@ -270,13 +307,26 @@ F_Exp::F_Exp() noexcept { name = "F"; f = [](float x) { return x * x; }; }
 void F_Exp::epoch() noexcept {
 	Genome* best = nullptr;
 	float avg = 0;
-	for (auto& x : pop.genomes) {
+	// The bias input, x and an unused third input as the population is created with 3 inputs.
+	constexpr size_t N_Rows = 10;
+	float inputs[N_Rows * 3];
+	float targets[N_Rows];
+	for (size_t i = 0; i < N_Rows; ++i) {
+		float x = i / (float)N_Rows;
+		inputs[i * 3 + 0] = 1;
+		inputs[i * 3 + 1] = x;
+		inputs[i * 3 + 2] = 0;
+		targets[i] = f(x);
+	}
+
+	arena.build(pop.genomes);
+	outputs.resize(arena.size() * N_Rows);
+	arena.compute(inputs, N_Rows, outputs.data());
+
+	for (size_t g = 0; g < pop.genomes.size(); ++g) {
+		auto& x = pop.genomes[g];
 		x.fitness = 0;
-		auto net = Network::generate(x);
-		for (float i = 0; i < 1; i += 1 / 10.f) {
-			auto a = net.compute({1, i}).front() - f(i);
-			x.fitness += std::abs(a);
-		}
+		for (size_t i = 0; i < N_Rows; ++i) x.fitness += std::abs(outputs[g * N_Rows + i] - targets[i]);
 
 		avg += x.fitness;
 
@@ -296,9 +346,9 @@ void F_Exp::epoch() noexcept {
 	printf("Gen: %zu => %f\n", generation_number, 1 / best->fitness - 1);
 	printf("Species: %zu\n", pop.species.size());
 	{
-		auto net = Network::generate(*best);
-		for (float i = 0; i < 1; i += 1 / 10.f) {
-			printf("f(%f) = %f (%f)\n", i, net.compute({1, i}).front(), f(i));
+		size_t g = best - pop.genomes.data();
+		for (size_t i = 0; i < N_Rows; ++i) {
+			printf("f(%f) = %f (%f)\n", inputs[i * 3 + 1], outputs[g * N_Rows + i], targets[i]);
 		}
 	}
 	printf("%s\n", best->to_string().c_str());
@@ -2,10 +2,13 @@
 
 #include "IA/Population.hpp"
 #include "IA/Genome.hpp"
+#include "IA/Network_Arena.hpp"
+#include "IA/Compiled_Network.hpp"
 
 #include <string>
 #include <functional>
 #include <array>
+#include <future>
 #include <thread>
 #include <mutex>
 
@@ -33,11 +36,25 @@ struct Exp {
 	std::vector<float> species_size;
 	std::array<float, 100> cumulative_fitness;
 
+	// Networks of the current generation and their outputs on the dataset of the experiment.
+	Network_Arena arena;
+	std::vector<float> outputs;
+
+	// Best genome built to native code. The build runs on its own thread and only hands its
+	// result back through champion_build, champion is only touched by the render thread.
+	Compiled_Network champion;
+	size_t champion_generation = 0;
+	std::future<Compiled_Network> champion_build;
+	size_t champion_build_generation = 0;
+
+	virtual ~Exp() noexcept;
+
 	virtual void epoch() noexcept = 0;
 	virtual void launch() noexcept;
 
 	virtual void render(ImGui_State& imgui_state) noexcept;
 
+	// Called with mutex held.
 	void render_stats(ImGui_State& imgui_state) noexcept;
 	void render_params(ImGui_State& imgui_state) noexcept;
 };
@@ -0,0 +1,360 @@
+#include "Game_Batch.hpp"
+
+#include <algorithm>
+
+#include "macros.hpp"
+
+namespace {
+	// Free function so that the restrict qualifiers are honored and the loop is vectorised.
+	void act_kernel(
+		size_t n,
+		bool raised_turn,
+		uint32_t bb_seat,
+		const uint32_t* __restrict pass,
+		const uint32_t* __restrict bb_idx,
+		uint32_t* __restrict running_bet,
+		uint32_t* __restrict pot,
+		uint32_t* __restrict stack,
+		uint32_t* __restrict bet,
+		uint32_t* __restrict current_bet,
+		uint32_t* __restrict fold,
+		const uint32_t* __restrict stack_1,
+		const uint32_t* __restrict current_bet_1,
+		const uint32_t* __restrict stack_2,
+		const uint32_t* __restrict current_bet_2
+	) noexcept {
+		// Flags are 0 or 1 in 32 bits lanes, bools would mix widths.
+		uint32_t raised = raised_turn;
+
+		for (size_t t = 0; t < n; ++t) {
+			uint32_t rb = running_bet[t];
+			uint32_t st = stack[t];
+			uint32_t cb = current_bet[t];
+
+			uint32_t acting =
+				pass[t] & (uint32_t)(bb_idx[t] == bb_seat) & (uint32_t)(fold[t] == 0) & (uint32_t)(st > 0);
+
+			uint32_t to_raise = std::min(rb + 10u, st);
+			uint32_t can_raise =
+				(uint32_t)(stack_1[t] + current_bet_1[t] > to_raise + rb) |
+				(uint32_t)(stack_2[t] + current_bet_2[t] > to_raise + rb);
+
+			uint32_t folding = acting & raised & (uint32_t)(rb > st);
+			uint32_t raising = acting & (raised ^ 1) & can_raise;
+			uint32_t following = acting & (folding ^ 1) & (raising ^ 1);
+
+			uint32_t pay = following * (rb - cb) + raising * to_raise;
+
+			stack[t] = st - pay;
+			bet[t] += pay;
+			pot[t] += pay;
+			current_bet[t] = cb + pay;
+			running_bet[t] = rb + raising * (std::max(rb, to_raise) - rb);
+			fold[t] |= folding;
+		}
+	}
+
+	void blind_kernel(
+		size_t n,
+		uint32_t seat,
+		uint32_t big_blind,
+		const uint32_t* __restrict bb_idx,
+		uint32_t* __restrict stack,
+		uint32_t* __restrict pot
+	) noexcept {
+		uint32_t small_idx = (seat + 1) % 3;
+		for (size_t t = 0; t < n; ++t) {
+			uint32_t blind = bb_idx[t] == seat ? big_blind : (bb_idx[t] == small_idx ? big_blind / 2 : 0);
+			uint32_t paid = std::min(stack[t], blind);
+
+			stack[t] -= paid;
+			pot[t] += paid;
+		}
+	}
+}
+
+void Game_Batch::resize(size_t n) noexcept {
+	n_tables = n;
+
+	for (size_t s = 0; s < N_Seats; ++s) {
+		stacks[s].resize(n);
+		bets[s].resize(n);
+		current_bets[s].resize(n);
+		folded[s].resize(n);
+		holes[s].resize(n);
+	}
+
+	boards.resize(n);
+	pots.resize(n);
+	running_bets.resize(n);
+	big_blind_idx.resize(n);
+	in_pass.resize(n);
+	hands_played.resize(n);
+	decks.resize(n);
+	rngs.resize(n);
+
+	ids.resize(n);
+	slots.resize(n);
+	for (size_t i = 0; i < n; ++i) ids[i] = slots[i] = (uint32_t)i;
+
+	reset();
+}
+
+void Game_Batch::seed(uint64_t seed) noexcept {
+	for (size_t t = 0; t < n_tables; ++t) rngs[slots[t]] = pcg32_seed(seed, t);
+}
+
+void Game_Batch::reset() noexcept {
+	for (size_t s = 0; s < N_Seats; ++s) {
+		std::fill(BEG_END(stacks[s]), starting_stack);
+		std::fill(BEG_END(bets[s]), 0);
+		std::fill(BEG_END(current_bets[s]), 0);
+		std::fill(BEG_END(folded[s]), 0);
+		std::fill(BEG_END(holes[s]), 0);
+	}
+
+	std::fill(BEG_END(boards), 0);
+	std::fill(BEG_END(pots), 0);
+	std::fill(BEG_END(running_bets), 0);
+	std::fill(BEG_END(big_blind_idx), 0);
+	std::fill(BEG_END(hands_played), 0);
+	std::fill(BEG_END(decks), Deck{});
+	n_active = n_tables;
+}
+
+void Game_Batch::swap_slots(size_t a, size_t b) noexcept {
+	auto swap = [&](auto& v) { std::swap(v[a], v[b]); };
+
+	for (size_t s = 0; s < N_Seats; ++s) {
+		swap(stacks[s]);
+		swap(bets[s]);
+		swap(current_bets[s]);
+		swap(folded[s]);
+		swap(holes[s]);
+	}
+
+	swap(boards);
+	swap(pots);
+	swap(running_bets);
+	swap(big_blind_idx);
+	swap(hands_played);
+	swap(decks);
+	swap(rngs);
+
+	swap(ids);
+	slots[ids[a]] = (uint32_t)a;
+	slots[ids[b]] = (uint32_t)b;
+}
+
+void Game_Batch::compact() noexcept {
+	// Same test as Game::over.
+	size_t i = 0;
+	while (i < n_active) {
+		uint32_t alive = 0;
+		for (size_t s = 0; s < N_Seats; ++s) alive += stacks[s][i] > 0;
+
+		if (alive > 1) i++;
+		else swap_slots(i, --n_active);
+	}
+}
+
+size_t Game_Batch::play_hand() noexcept {
+	compact();
+	if (!n_active) return 0;
+
+	std::fill_n(pots.data(), n_active, 0);
+	std::fill_n(boards.data(), n_active, 0);
+	for (size_t s = 0; s < N_Seats; ++s) {
+		std::fill_n(bets[s].data(), n_active, 0);
+		std::fill_n(current_bets[s].data(), n_active, 0);
+		std::fill_n(folded[s].data(), n_active, 0);
+	}
+
+	deal();
+	blinds();
+
+	round();
+	for (size_t t = 0; t < n_active; ++t) {
+		CardSet board;
+		for (size_t i = 0; i < 3; ++i) board.insert(decks[t].draw(rngs[t]));
+		boards[t] = board.bits;
+	}
+
+	round();
+	for (size_t t = 0; t < n_active; ++t) boards[t] |= CardSet::from(decks[t].draw(rngs[t])).bits;
+
+	round();
+	for (size_t t = 0; t < n_active; ++t) boards[t] |= CardSet::from(decks[t].draw(rngs[t])).bits;
+
+	round();
+	showdown();
+
+	for (size_t t = 0; t < n_active; ++t) {
+		big_blind_idx[t] = (big_blind_idx[t] + 1) % N_Seats;
+		hands_played[t]++;
+	}
+
+	return n_active;
+}
+
+void Game_Batch::play_games() noexcept {
+	while (play_hand());
+}
+
+void Game_Batch::deal() noexcept {
+	// Same drawing order as Game::play_new_hand, busted players included.
+	for (size_t t = 0; t < n_active; ++t) {
+		decks[t].reset();
+		for (size_t s = 0; s < N_Seats; ++s) {
+			CardSet hole;
+			hole.insert(decks[t].draw(rngs[t]));
+			hole.insert(decks[t].draw(rngs[t]));
+			holes[s][t] = hole.bits;
+		}
+	}
+}
+
+void Game_Batch::blinds() noexcept {
+	size_t n = n_active;
+
+	for (size_t s = 0; s < N_Seats; ++s) {
+		blind_kernel(n, (uint32_t)s, big_blind, big_blind_idx.data(), stacks[s].data(), pots.data());
+	}
+
+	std::fill_n(running_bets.data(), n, big_blind);
+
+	for (size_t s = 0; s < N_Seats; ++s) {
+		auto* stack = stacks[s].data();
+		auto* fold = folded[s].data();
+		for (size_t t = 0; t < n; ++t) fold[t] |= stack[t] == 0;
+	}
+}
+
+void Game_Batch::round() noexcept {
+	size_t n = n_active;
+	std::fill_n(in_pass.data(), n, 1);
+	for (size_t step = 0; step < N_Seats; ++step) act(step, false);
+
+	auto* pass = in_pass.data();
+	auto* rb = running_bets.data();
+	uint32_t bb = big_blind;
+
+	for (size_t t = 0; t < n; ++t) pass[t] = rb[t] > bb;
+	for (size_t step = 0; step < N_Seats; ++step) act(step, true);
+
+	for (size_t t = 0; t < n; ++t) rb[t] = pass[t] ? 0 : rb[t];
+	for (size_t s = 0; s < N_Seats; ++s) {
+		auto* current_bet = current_bets[s].data();
+		for (size_t t = 0; t < n; ++t) current_bet[t] = pass[t] ? 0 : current_bet[t];
+	}
+}
+
+void Game_Batch::act(size_t step, bool raised_turn) noexcept {
+	// The step-th player after the big blind acts: Agent::act and Game::apply for every table at
+	// once. Each call of the kernel only writes the arrays of one seat.
+	for (size_t s = 0; s < N_Seats; ++s) {
+		act_kernel(
+			n_active,
+			raised_turn,
+			// The big blind seat for which s is the step-th to act.
+			(uint32_t)((s + 2 * N_Seats - 1 - step) % N_Seats),
+			in_pass.data(),
+			big_blind_idx.data(),
+			running_bets.data(),
+			pots.data(),
+			stacks[s].data(),
+			bets[s].data(),
+			current_bets[s].data(),
+			folded[s].data(),
+			stacks[(s + 1) % N_Seats].data(),
+			current_bets[(s + 1) % N_Seats].data(),
+			stacks[(s + 2) % N_Seats].data(),
+			current_bets[(s + 2) % N_Seats].data()
+		);
+	}
+}
+
+void Game_Batch::showdown() noexcept {
+	for (size_t t = 0; t < n_active; ++t) {
+		CardSet board{ boards[t] };
+
+		std::array<uint16_t, N_Seats> strengths;
+		uint16_t best = 0;
+		for (size_t s = 0; s < N_Seats; ++s) {
+			// Folded players get 0, below any hand. Strengths are shifted by one to keep 0 free.
+			auto strength = Combo::evaluate(board | CardSet{ holes[s][t] }).strength + 1;
+			strengths[s] = folded[s][t] ? 0 : (uint16_t)strength;
+			best = std::max(best, strengths[s]);
+		}
+
+		uint32_t n_winners = 0;
+		for (size_t s = 0; s < N_Seats; ++s) n_winners += best && strengths[s] == best;
+		if (!n_winners) continue;
+
+		uint32_t share = pots[t] / n_winners;
+		for (size_t s = 0; s < N_Seats; ++s) stacks[s][t] += strengths[s] == best ? share : 0;
+	}
+}
+
+void Game_Batch::view(size_t table, Game& game) const noexcept {
+	size_t t = slots[table];
+
+	for (size_t s = 0; s < N_Seats; ++s) {
+		auto& p = game.players[s];
+		p.stack = stacks[s][t];
+		p.bet = bets[s][t];
+		p.current_bet = current_bets[s][t];
+		p.folded = folded[s][t];
+		CardSet{ holes[s][t] }.to_cards(p.hand.data());
+	}
+
+	// Only the drawn cards, the others keep the zeroed cards of the hand.
+	std::array<Card, 5> board;
+	game.current_hand = {};
+	size_t n_board = game.current_hand.n_board = CardSet{ boards[t] }.to_cards(board.data());
+	for (size_t i = 0; i < std::min(n_board, game.current_hand.flop.size()); ++i)
+		game.current_hand.flop[i] = board[i];
+	if (n_board > 3) game.current_hand.turn = board[3];
+	if (n_board > 4) game.current_hand.river = board[4];
+	game.current_hand.pot = pots[t];
+	game.current_hand.big_blind = big_blind;
+
+	game.starting_stack = starting_stack;
+	game.big_blind = big_blind;
+	game.big_bling_idx = big_blind_idx[t];
+	game.running_bet = running_bets[t];
+	game.deck = decks[t];
+	game.rng = rngs[t];
+}
+
+void Game_Batch::load(size_t table, const Game& game) noexcept {
+	size_t t = slots[table];
+
+	for (size_t s = 0; s < N_Seats; ++s) {
+		auto& p = game.players[s];
+		stacks[s][t] = (uint32_t)p.stack;
+		bets[s][t] = (uint32_t)p.bet;
+		current_bets[s][t] = (uint32_t)p.current_bet;
+		folded[s][t] = p.folded;
+		holes[s][t] = CardSet::from(p.hand).bits;
+	}
+
+	std::array<Card, 5> board = {
+		game.current_hand.flop[0],
+		game.current_hand.flop[1],
+		game.current_hand.flop[2],
+		game.current_hand.turn,
+		game.current_hand.river
+	};
+	boards[t] = CardSet::from(board.data(), game.current_hand.n_board).bits;
+	pots[t] = (uint32_t)game.current_hand.pot;
+
+	big_blind_idx[t] = (uint32_t)(game.big_bling_idx % N_Seats);
+	running_bets[t] = (uint32_t)game.running_bet;
+	hands_played[t] = (uint32_t)game.history.total;
+	decks[t] = game.deck;
+	rngs[t] = game.rng;
+
+	// A finished table can be brought back into the active range.
+	if (t >= n_active) swap_slots(t, n_active++);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <stdint.h>
+
+#include "poker.hpp"
+
+// Many 3 players tables played in lock step with the default Agent policy (no preflop table).
+// Everything is stored as structure of arrays, one entry per table, so a betting step or a
+// showdown is a single branch free loop over the tables that the compiler can vectorise. Every
+// lane is 32 bits wide, even flags, mixing widths prevents the vectorisation.
+// Table t plays exactly the same game as a Game seeded with the same seed and stream t.
+//
+// The arrays are indexed by slot, not by table: tables whose game is over are swapped behind the
+// first n_active slots so the loops never go through finished tables. slots[table] is where a
+// table lives and ids[slot] the table in a slot.
+struct Game_Batch {
+	static constexpr size_t N_Seats = 3;
+
+	template<typename T>
+	using Per_Seat = std::array<std::vector<T>, N_Seats>;
+
+	size_t n_tables{ 0 };
+	size_t n_active{ 0 };
+
+	std::vector<uint32_t> ids;
+	std::vector<uint32_t> slots;
+
+	Per_Seat<uint32_t> stacks;
+	Per_Seat<uint32_t> bets;
+	Per_Seat<uint32_t> current_bets;
+	Per_Seat<uint32_t> folded;
+	// CardSet bits.
+	Per_Seat<uint64_t> holes;
+
+	std::vector<uint64_t> boards;
+	std::vector<uint32_t> pots;
+	std::vector<uint32_t> running_bets;
+	std::vector<uint32_t> big_blind_idx;
+	std::vector<uint32_t> hands_played;
+
+	std::vector<Deck> decks;
+	std::vector<pcg32_random_t> rngs;
+
+	uint32_t starting_stack{ 500 };
+	uint32_t big_blind{ 10 };
+
+	void resize(size_t n) noexcept;
+	// Table t gets the stream t.
+	void seed(uint64_t seed) noexcept;
+	// Every table back to the starting stacks.
+	void reset() noexcept;
+
+	// One hand on every table still running, returns how many tables played.
+	size_t play_hand() noexcept;
+	// Plays hands until every game is over.
+	void play_games() noexcept;
+
+	// Single table view for debugging, the names and agents of the game are left untouched.
+	void view(size_t table, Game& game) const noexcept;
+	void load(size_t table, const Game& game) noexcept;
+
+private:
+	// Tables taking part in the current betting pass.
+	std::vector<uint32_t> in_pass;
+
+	void compact() noexcept;
+	void swap_slots(size_t a, size_t b) noexcept;
+	void deal() noexcept;
+	void blinds() noexcept;
+	void round() noexcept;
+	void act(size_t step, bool raised_turn) noexcept;
+	void showdown() noexcept;
+};
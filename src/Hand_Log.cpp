@@ -0,0 +1,206 @@
+#include "Hand_Log.hpp"
+
+#include <string.h>
+
+namespace {
+	uint8_t* write_varint(uint8_t* out, uint64_t x) noexcept {
+		while (x >= 0x80) {
+			*out++ = (uint8_t)(x | 0x80);
+			x >>= 7;
+		}
+		*out++ = (uint8_t)x;
+		return out;
+	}
+
+	const uint8_t* read_varint(const uint8_t* it, const uint8_t* end, uint64_t& x) noexcept {
+		x = 0;
+		for (size_t shift = 0; it < end && shift < 64; shift += 7) {
+			uint8_t byte = *it++;
+			x |= (uint64_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) return it;
+		}
+		return nullptr;
+	}
+}
+
+size_t Hand_Log::encode(const Hand_Record& record, uint8_t* out) noexcept {
+	uint8_t body[Max_Record_Size];
+	uint8_t* it = body;
+
+	for (size_t seat = 0; seat < 3; ++seat) {
+		auto hole = CardSet::from(record.hole(seat, 0)) | CardSet::from(record.hole(seat, 1));
+		it = write_varint(it, hole.bits);
+	}
+
+	auto flop =
+		CardSet::from(record.board_card(0)) |
+		CardSet::from(record.board_card(1)) |
+		CardSet::from(record.board_card(2));
+	it = write_varint(it, flop.bits);
+	*it++ = record.board[3];
+	*it++ = record.board[4];
+
+	*it++ = (uint8_t)((record.big_blind_idx & 0b11) | (record.winners << 2));
+	it = write_varint(it, record.pot);
+
+	it = write_varint(it, record.n_actions);
+	for (size_t i = 0; i < record.n_actions; ++i) it = write_varint(it, record.actions[i]);
+
+	size_t body_size = it - body;
+	uint8_t* begin = out;
+	out = write_varint(out, body_size);
+	memcpy(out, body, body_size);
+	return out + body_size - begin;
+}
+
+const uint8_t* Hand_Log::decode(
+	const uint8_t* it, const uint8_t* end, Hand_Record& record
+) noexcept {
+	uint64_t size;
+	it = read_varint(it, end, size);
+	if (!it || size > (uint64_t)(end - it)) return nullptr;
+
+	end = it + size;
+	record = {};
+
+	uint64_t x;
+	for (size_t seat = 0; seat < 3; ++seat) {
+		if (!(it = read_varint(it, end, x))) return nullptr;
+		CardSet hole{ x };
+		if (hole.size() != 2) return nullptr;
+		record.holes[seat * 2 + 0] = (uint8_t)CardSet::index(hole.pop());
+		record.holes[seat * 2 + 1] = (uint8_t)CardSet::index(hole.pop());
+	}
+
+	if (!(it = read_varint(it, end, x))) return nullptr;
+	CardSet flop{ x };
+	if (flop.size() != 3) return nullptr;
+	for (size_t i = 0; i < 3; ++i) record.board[i] = (uint8_t)CardSet::index(flop.pop());
+
+	if (end - it < 3) return nullptr;
+	record.board[3] = *it++;
+	record.board[4] = *it++;
+	record.big_blind_idx = *it & 0b11;
+	record.winners = *it++ >> 2;
+
+	if (!(it = read_varint(it, end, x))) return nullptr;
+	record.pot = (uint32_t)x;
+
+	if (!(it = read_varint(it, end, x)) || x > Hand_Record::Max_Actions) return nullptr;
+	record.n_actions = (uint8_t)x;
+	for (size_t i = 0; i < record.n_actions; ++i) {
+		if (!(it = read_varint(it, end, x))) return nullptr;
+		record.actions[i] = (uint32_t)x;
+	}
+
+	// Anything left belongs to a later version of the format.
+	return end;
+}
+
+Hand_Log_Writer::~Hand_Log_Writer() noexcept {
+	close();
+}
+
+bool Hand_Log_Writer::open(const std::filesystem::path& path, size_t buffer_size) noexcept {
+	close();
+
+	std::error_code ec;
+	bool exists = std::filesystem::exists(path, ec) && std::filesystem::file_size(path, ec) > 0;
+	if (ec) return false;
+
+	if (exists) {
+		FILE* existing = fopen(path.string().c_str(), "rb");
+		if (!existing) return false;
+
+		uint32_t header[2];
+		size_t read = fread(header, 1, Hand_Log::Header_Size, existing);
+		fclose(existing);
+		if (read != Hand_Log::Header_Size) return false;
+		if (header[0] != Hand_Log::Magic || header[1] != Hand_Log::Version) return false;
+	}
+
+	file = fopen(path.string().c_str(), "ab");
+	if (!file) return false;
+
+	buffer.resize(std::max(buffer_size, Hand_Log::Max_Record_Size));
+	used = 0;
+	written = 0;
+
+	if (!exists) {
+		uint32_t header[] = { Hand_Log::Magic, Hand_Log::Version };
+		memcpy(buffer.data(), header, Hand_Log::Header_Size);
+		used = Hand_Log::Header_Size;
+	}
+
+	return true;
+}
+
+bool Hand_Log_Writer::close() noexcept {
+	if (!file) return true;
+	bool ok = flush();
+	ok &= fclose(file) == 0;
+	file = nullptr;
+	return ok;
+}
+
+bool Hand_Log_Writer::write(const Hand_Record& record) noexcept {
+	if (!file || ferror(file)) return false;
+	if (buffer.size() - used < Hand_Log::Max_Record_Size && !flush()) return false;
+
+	used += Hand_Log::encode(record, buffer.data() + used);
+	written++;
+	return true;
+}
+
+bool Hand_Log_Writer::flush() noexcept {
+	if (!file) return true;
+
+	bool ok = fwrite(buffer.data(), 1, used, file) == used;
+	used = 0;
+	// The error flag of the stream stays set, a failed flush fails every later one.
+	return ok && fflush(file) == 0 && !ferror(file);
+}
+
+Hand_Log_Reader::~Hand_Log_Reader() noexcept {
+	close();
+}
+
+bool Hand_Log_Reader::open(const std::filesystem::path& path) noexcept {
+	close();
+
+	auto mapped = file::map_file(path);
+	if (!mapped) return false;
+	file = *mapped;
+
+	uint32_t header[2];
+	if (file.size < Hand_Log::Header_Size) {
+		close();
+		return false;
+	}
+	memcpy(header, file.data, Hand_Log::Header_Size);
+	if (header[0] != Hand_Log::Magic || header[1] != Hand_Log::Version) {
+		close();
+		return false;
+	}
+
+	rewind();
+	return true;
+}
+
+void Hand_Log_Reader::close() noexcept {
+	file::unmap_file(file);
+	it = nullptr;
+}
+
+bool Hand_Log_Reader::next(Hand_Record& record) noexcept {
+	if (!it) return false;
+
+	auto end = file.data + file.size;
+	if (it >= end) return false;
+
+	auto after = Hand_Log::decode(it, end, record);
+	if (!after) return false;
+
+	it = after;
+	return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <filesystem>
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "poker.hpp"
+#include "OS/file.hpp"
+
+// Append only binary log of Hand_Record.
+//
+// File layout:
+//   uint32 magic "PKHL", uint32 version
+//   records, each one is a varint byte length followed by:
+//     3 varints, the hole cards of every seat as CardSet bits
+//     1 varint, the flop as CardSet bits
+//     2 bytes, the turn and the river card indices
+//     1 byte, the big blind seat in the 2 lower bits and the winners mask above
+//     1 varint, the pot
+//     1 varint, the number of actions then one varint per packed action (see Hand_Record)
+// The length prefix lets a reader skip records it does not understand in later versions.
+struct Hand_Log {
+	static constexpr uint32_t Magic = 0x4C484B50; // "PKHL"
+	static constexpr uint32_t Version = 1;
+	static constexpr size_t Header_Size = 2 * sizeof(uint32_t);
+	// Upper bound of an encoded record, length prefix included.
+	static constexpr size_t Max_Record_Size = 2 + 4 * 10 + 3 + 5 + 1 + 5 * Hand_Record::Max_Actions;
+
+	// Returns the number of bytes written in out, at most Max_Record_Size.
+	static size_t encode(const Hand_Record& record, uint8_t* out) noexcept;
+	// Returns the end of the record, nullptr if it is truncated or malformed.
+	static const uint8_t* decode(const uint8_t* it, const uint8_t* end, Hand_Record& record) noexcept;
+};
+
+struct Hand_Log_Writer {
+	Hand_Log_Writer() noexcept = default;
+	Hand_Log_Writer(const Hand_Log_Writer&) = delete;
+	Hand_Log_Writer& operator=(const Hand_Log_Writer&) = delete;
+	~Hand_Log_Writer() noexcept;
+
+	// Appends to the file if it already is a log of this version, creates it if it is missing or
+	// empty. Fails on any other file.
+	bool open(const std::filesystem::path& path, size_t buffer_size = 1 << 20) noexcept;
+	// False if anything written since open did not make it to the file.
+	bool close() noexcept;
+	bool is_open() const noexcept { return file != nullptr; }
+
+	// False once the file is in error, the records buffered since the last flush may be lost.
+	bool write(const Hand_Record& record) noexcept;
+	bool flush() noexcept;
+
+	size_t written{ 0 };
+
+private:
+	FILE* file{ nullptr };
+	std::vector<uint8_t> buffer;
+	size_t used{ 0 };
+};
+
+// Reads the records straight from the memory mapped file.
+struct Hand_Log_Reader {
+	Hand_Log_Reader() noexcept = default;
+	Hand_Log_Reader(const Hand_Log_Reader&) = delete;
+	Hand_Log_Reader& operator=(const Hand_Log_Reader&) = delete;
+	~Hand_Log_Reader() noexcept;
+
+	bool open(const std::filesystem::path& path) noexcept;
+	void close() noexcept;
+
+	// False at the end of the log or on a truncated record.
+	bool next(Hand_Record& record) noexcept;
+	void rewind() noexcept { it = file.data ? file.data + Hand_Log::Header_Size : nullptr; }
+
+private:
+	file::Mapped_File file;
+	const uint8_t* it{ nullptr };
+};
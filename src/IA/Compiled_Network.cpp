@@ -0,0 +1,266 @@
+#include "Compiled_Network.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+
+namespace {
+	std::string literal(float x) noexcept {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.9gf", x);
+
+		std::string s = buffer;
+		// "1f" is not a float literal.
+		if (s.find_first_of(".e") == std::string::npos) s.insert(s.size() - 1, ".0");
+		return "(" + s + ")";
+	}
+
+	std::string slot(size_t i) noexcept {
+		return "s" + std::to_string(i);
+	}
+
+	std::string activation(Network::Node::Activation func, const std::string& x, bool fast) noexcept {
+		using Activation = Network::Node::Activation;
+		switch (func) {
+		case Activation::Sig:
+			return fast ? "fast_math::fast_sigmoid(" + x + ")" : "1 / (1 + std::exp(-" + x + "))";
+		case Activation::Tanh:
+			return fast ? "fast_math::fast_tanh(" + x + ")" : "std::tanh(" + x + ")";
+		case Activation::Relu:
+			return x + " > 0 ? " + x + " : 0.f";
+		case Activation::Sign:
+			return x + " > 0 ? 1.f : 0.f";
+		case Activation::Cos:
+			return fast ? "fast_math::fast_cos(" + x + ")" : "std::cos(" + x + ")";
+		case Activation::Sin:
+			return fast ? "fast_math::fast_sin(" + x + ")" : "std::sin(" + x + ")";
+		default:
+			return x;
+		}
+	}
+
+	std::string quote(const std::filesystem::path& path) noexcept {
+		return "\"" + path.string() + "\"";
+	}
+
+	// stem + ext, stem may already contain dots.
+	std::filesystem::path path_with(const std::filesystem::path& stem, const char* ext) noexcept {
+		auto path = stem;
+		path += ext;
+		return path;
+	}
+
+	std::string read_file(const std::filesystem::path& path) noexcept {
+		std::ifstream file(path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	}
+}
+
+Compiled_Network::Compiled_Network(Compiled_Network&& other) noexcept {
+	*this = std::move(other);
+}
+
+Compiled_Network& Compiled_Network::operator=(Compiled_Network&& other) noexcept {
+	if (this == &other) return *this;
+
+	library::unload_library(library);
+	network = std::move(other.network);
+	function = other.function;
+	library = other.library;
+
+	other.function = nullptr;
+	other.library = {};
+	return *this;
+}
+
+Compiled_Network::~Compiled_Network() noexcept {
+	library::unload_library(library);
+}
+
+void Compiled_Network::compute(const float* inputs, size_t n_rows, float* outputs) noexcept {
+	if (function) function(inputs, n_rows, outputs);
+	else          network.compute(inputs, n_rows, outputs);
+}
+
+std::string Compiled_Network::emit_source(const Network& network) noexcept {
+	auto& plan = network.plan;
+	bool fast = network.fast_activations;
+
+	std::string src;
+	src += "// Generated from a genome.\n";
+	src += "#include <cmath>\n";
+	src += "#include <stddef.h>\n";
+	if (fast) src += "#include \"IA/Fast_Math.hpp\"\n";
+	src += "\n";
+	src += "#ifdef _WIN32\n";
+	src += "extern \"C\" __declspec(dllexport)\n";
+	src += "#else\n";
+	src += "extern \"C\"\n";
+	src += "#endif\n";
+	src += "void " + std::string(Symbol) + "(const float* inputs, size_t n_rows, float* outputs) {\n";
+	src += "\tfor (size_t r = 0; r < n_rows; ++r) {\n";
+	src += "\t\tconst float* in = inputs + r * " + std::to_string(network.n_inputs) + ";\n";
+	src += "\t\tfloat* out = outputs + r * " + std::to_string(network.n_outputs) + ";\n\n";
+
+	for (size_t i = 0; i < network.n_inputs; ++i)
+		src += "\t\tconst float " + slot(i) + " = in[" + std::to_string(i) + "];\n";
+
+	size_t n_cells = 0;
+	for (size_t k = 0; k < plan.order.size(); ++k) {
+		auto func = plan.funcs[k];
+		bool product = func == Network::Node::Activation::Mult;
+
+		// Same order of operations as the interpreter, delayed links read 0 and are left out.
+		std::string sum;
+		bool zero = product && plan.offsets[k] == plan.offsets[k + 1];
+		for (size_t l = plan.offsets[k]; l < plan.offsets[k + 1]; ++l) {
+			if (plan.sources[l] >= network.n_slots) {
+				zero |= product;
+				continue;
+			}
+			sum += (product ? " * (" : " + ") + slot(plan.sources[l]) + " * " + literal(plan.weights[l]);
+			if (product) sum += ")";
+		}
+		if (zero) sum = "0.f";
+		else      sum = (product ? "1.f" : "0.f") + sum;
+
+		auto s = slot(network.n_inputs + k);
+		src += "\t\tfloat " + s + " = " + sum + ";\n";
+
+		// No previous cell, the forget gate has nothing to keep.
+		if (func == Network::Node::Activation::LSTM) {
+			auto& cell = plan.cells[n_cells++];
+			auto gate = [&](float w, float b) {
+				return activation(Network::Node::Activation::Sig, "(" + literal(w) + " * " + s + " + " + literal(b) + ")", fast);
+			};
+			src += "\t\t{\n";
+			src += "\t\t\tfloat in = " + gate(cell.gates.input_w, cell.gates.input_b) + ";\n";
+			src += "\t\t\tfloat out = " + gate(cell.gates.output_w, cell.gates.output_b) + ";\n";
+			src += "\t\t\tfloat candidate = " + s + ";\n";
+			auto candidate = activation(cell.func, "candidate", fast);
+			if (candidate != "candidate") src += "\t\t\tcandidate = " + candidate + ";\n";
+			src += "\t\t\tfloat memory = in * candidate;\n";
+			src += "\t\t\t" + s + " = out * " + activation(Network::Node::Activation::Tanh, "memory", fast) + ";\n";
+			src += "\t\t}\n";
+			continue;
+		}
+
+		auto applied = activation(func, s, fast);
+		if (applied != s) src += "\t\t" + s + " = " + applied + ";\n";
+	}
+
+	src += "\n";
+	for (size_t o = 0; o < network.n_outputs; ++o)
+		src += "\t\tout[" + std::to_string(o) + "] = " + slot(plan.output_slots[o]) + ";\n";
+
+	src += "\t}\n";
+	src += "}\n";
+	return src;
+}
+
+Compiled_Network Compiled_Network::compile(const Genome& genome, bool fast_activations) noexcept {
+	return compile(genome, fast_activations, Options{});
+}
+
+Compiled_Network Compiled_Network::compile(
+	const Genome& genome, bool fast_activations, const Options& options
+) noexcept {
+	Compiled_Network result;
+	result.network = Network::generate(genome);
+	result.network.fast_activations = fast_activations;
+
+	auto directory = options.directory;
+	if (directory.empty()) {
+		auto cache = library::cache_directory("poker_networks");
+		if (!cache) return result;
+		directory = *cache;
+	}
+	else if (!library::make_private_directory(directory)) return result;
+
+	std::string compiler = options.compiler;
+	if (compiler.empty() && getenv("CXX")) compiler = getenv("CXX");
+#ifdef _WIN32
+	if (compiler.empty()) compiler = "cl";
+#else
+	if (compiler.empty()) compiler = "c++";
+#endif
+
+	bool msvc = compiler == "cl" || compiler.ends_with("cl.exe");
+	std::string flags = msvc
+		? "/nologo /O2 /LD /EHsc /std:c++20"
+		: "-std=c++20 -O2 -ffp-contract=off -shared -fPIC";
+
+	auto src = emit_source(result.network);
+
+	// The name covers everything the library is built from, the included header as well.
+	std::string key = src + "\n" + compiler + " " + flags + "\n";
+	if (fast_activations) key += read_file(options.include_directory / "IA" / "Fast_Math.hpp");
+
+	char name[32];
+	snprintf(name, sizeof(name), "network_%016zx", std::hash<std::string>{}(key));
+	auto lib_path = directory / (std::string(name) + library::extension());
+
+	if (!std::filesystem::exists(lib_path)) {
+		// Built under a name of its own then renamed, another process never loads a partial
+		// library or mixes its files with ours.
+		std::random_device device;
+		char unique[64];
+		snprintf(unique, sizeof(unique), "%s.%08x%08x", name, device(), device());
+		auto stem = directory / unique;
+
+		auto src_path = path_with(stem, ".cpp");
+		auto tmp_path = path_with(stem, library::extension());
+		auto log_path = path_with(stem, ".log");
+		{
+			std::ofstream file(src_path, std::ios::binary);
+			if (!file) return result;
+			file << src;
+		}
+
+		std::string command;
+		if (msvc) {
+			command =
+				compiler + " " + flags + " /I" + quote(options.include_directory) +
+				" " + quote(src_path) +
+				" /Fe" + quote(tmp_path) +
+				" /Fo" + quote(path_with(stem, ".obj"));
+		}
+		else {
+			command =
+				compiler + " " + flags + " -I" + quote(options.include_directory) +
+				" -o " + quote(tmp_path) + " " + quote(src_path);
+		}
+		command += " > " + quote(log_path) + " 2>&1";
+
+#ifdef _WIN32
+		// cmd strips the outer quotes of the whole line.
+		command = "\"" + command + "\"";
+#endif
+		// The source and the log are kept when the build fails.
+		if (system(command.c_str()) != 0) return result;
+
+		std::error_code ec;
+		std::filesystem::rename(tmp_path, lib_path, ec);
+		// Another process may have put the same library there first.
+		if (ec && !std::filesystem::exists(lib_path)) return result;
+
+		for (auto ext : { ".cpp", ".log", ".obj", ".lib", ".exp", library::extension() })
+			std::filesystem::remove(path_with(stem, ext), ec);
+	}
+
+	auto loaded = library::load_library(lib_path);
+	if (!loaded) return result;
+
+	auto function = (Function)library::find_symbol(*loaded, Symbol);
+	if (!function) {
+		library::unload_library(*loaded);
+		return result;
+	}
+
+	result.library = *loaded;
+	result.function = function;
+	return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+#include "Network.hpp"
+#include "OS/library.hpp"
+
+// A network turned into straight line C++ with its weights as constants, built into a shared
+// library by the local compiler and loaded back. When any step fails the interpreted plan is
+// used instead, compute gives the same results either way.
+// The generated function is stateless, links closing a cycle and LSTM cells read 0.
+struct Compiled_Network {
+	using Function = void (*)(const float* inputs, size_t n_rows, float* outputs);
+	static constexpr const char* Symbol = "network_compute";
+
+	struct Options {
+		// Also a cache, a network already built there with the same compiler and flags is loaded
+		// without compiling it again. Empty uses the poker_networks cache directory of the user.
+		// Must be private to the user, see library::make_private_directory.
+		std::filesystem::path directory;
+		// Empty uses $CXX, then cl on Windows and c++ elsewhere.
+		std::string compiler;
+		// To find IA/Fast_Math.hpp when the network uses the fast activations.
+		std::filesystem::path include_directory =
+			std::filesystem::path(__FILE__).parent_path().parent_path();
+	};
+
+	Network network;
+	Function function{ nullptr };
+	library::Library library;
+
+	Compiled_Network() noexcept = default;
+	Compiled_Network(const Compiled_Network&) = delete;
+	Compiled_Network& operator=(const Compiled_Network&) = delete;
+	Compiled_Network(Compiled_Network&& other) noexcept;
+	Compiled_Network& operator=(Compiled_Network&& other) noexcept;
+	~Compiled_Network() noexcept;
+
+	bool compiled() const noexcept { return function != nullptr; }
+
+	// Same layout as Network::compute.
+	void compute(const float* inputs, size_t n_rows, float* outputs) noexcept;
+
+	static std::string emit_source(const Network& network) noexcept;
+	static Compiled_Network compile(const Genome& genome, bool fast_activations = false) noexcept;
+	static Compiled_Network compile(
+		const Genome& genome, bool fast_activations, const Options& options
+	) noexcept;
+};
@@ -0,0 +1,465 @@
+#include "Gene_Pool.hpp"
+
+#include "Parallel.hpp"
+#include "Random/Random.hpp"
+#include "macros.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <tuple>
+
+namespace {
+	uint64_t mix(uint64_t h, uint64_t x) noexcept {
+		h ^= x + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+		return h;
+	}
+
+	uint64_t fingerprint(const Genome& genome) noexcept {
+		uint64_t h = mix(0, genome.node_genes.size());
+		for (auto& x : genome.connection_genes) {
+			uint32_t w;
+			memcpy(&w, &x.w, sizeof(w));
+			h = mix(mix(h, x.innov), w);
+		}
+		return h;
+	}
+}
+
+void Gene_Pool::set_enabled(size_t k, bool x) noexcept {
+	uint64_t bit = 1ull << (k % 64);
+	if (x) enabled[k / 64] |= bit;
+	else   enabled[k / 64] &= ~bit;
+}
+
+void Gene_Pool::or_bits(size_t i, uint64_t word) noexcept {
+	if (word) std::atomic_ref<uint64_t>(enabled[i]).fetch_or(word, std::memory_order_relaxed);
+}
+
+bool Gene_Pool::has_innovation(size_t g, size_t innov) const noexcept {
+	auto beg = BEG(innovs) + offsets[g];
+	auto end = BEG(innovs) + offsets[g + 1];
+	auto it = std::lower_bound(beg, end, innov, [](uint32_t a, size_t b) { return a < b; });
+	return it != end && *it == innov;
+}
+
+// Same hash as a Genome pushed in the pool.
+uint64_t Gene_Pool::fingerprint(size_t g) const noexcept {
+	uint64_t h = mix(0, n_nodes(g));
+	for (size_t k = offsets[g]; k < offsets[g + 1]; ++k) {
+		uint32_t w;
+		memcpy(&w, &weights[k], sizeof(w));
+		h = mix(mix(h, innovs[k]), w);
+	}
+	return h;
+}
+
+void Gene_Pool::clear() noexcept {
+	offsets.assign(1, 0);
+	ins.clear();
+	outs.clear();
+	innovs.clear();
+	weights.clear();
+	enabled.clear();
+	node_offsets.assign(1, 0);
+	nodes.clear();
+	fingerprints.clear();
+	pending_innovations.clear();
+	pending_genomes.clear();
+}
+
+void Gene_Pool::resize(size_t n, size_t n_genes, size_t n_nodes) noexcept {
+	offsets.resize(n + 1);
+	offsets[0] = 0;
+	ins.resize(n_genes);
+	outs.resize(n_genes);
+	innovs.resize(n_genes);
+	weights.resize(n_genes);
+	enabled.assign((n_genes + 63) / 64, 0);
+	node_offsets.resize(n + 1);
+	node_offsets[0] = 0;
+	nodes.resize(n_nodes);
+	fingerprints.resize(n);
+}
+
+void Gene_Pool::push_connection(uint32_t in, uint32_t out, uint32_t innov, float w, bool x) noexcept {
+	size_t k = ins.size();
+	ins.push_back(in);
+	outs.push_back(out);
+	innovs.push_back(innov);
+	weights.push_back(w);
+	if (k / 64 == enabled.size()) enabled.push_back(0);
+	set_enabled(k, x);
+}
+
+void Gene_Pool::push(const Genome& genome) noexcept {
+	if (offsets.empty()) clear();
+	if (!size()) {
+		n_inputs = genome.n_inputs;
+		n_outputs = genome.n_outputs;
+	}
+
+	for (auto& x : genome.connection_genes)
+		push_connection((uint32_t)x.in, (uint32_t)x.out, (uint32_t)x.innov, x.w, x.enabled);
+	offsets.push_back((uint32_t)ins.size());
+
+	nodes.insert(END(nodes), BEG_END(genome.node_genes));
+	node_offsets.push_back((uint32_t)nodes.size());
+	fingerprints.push_back(::fingerprint(genome));
+}
+
+void Gene_Pool::build(const std::vector<Genome>& genomes, size_t n_threads) noexcept {
+	size_t n_genes = 0;
+	size_t n_nodes = 0;
+	for (auto& x : genomes) {
+		n_genes += x.connection_genes.size();
+		n_nodes += x.node_genes.size();
+	}
+	resize(genomes.size(), n_genes, n_nodes);
+
+	n_inputs = genomes.empty() ? 0 : genomes.front().n_inputs;
+	n_outputs = genomes.empty() ? 0 : genomes.front().n_outputs;
+
+	for (size_t i = 0; i < genomes.size(); ++i) {
+		offsets[i + 1] = offsets[i] + (uint32_t)genomes[i].connection_genes.size();
+		node_offsets[i + 1] = node_offsets[i] + (uint32_t)genomes[i].node_genes.size();
+	}
+
+	parallel_for(genomes.size(), n_threads, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			auto& genome = genomes[i];
+
+			// A word of bits is written once, the ones at the ends are shared with the neighbours.
+			size_t word = offsets[i] / 64;
+			uint64_t bits = 0;
+			for (size_t j = 0; j < genome.connection_genes.size(); ++j) {
+				auto& x = genome.connection_genes[j];
+				size_t k = offsets[i] + j;
+				if (k / 64 != word) {
+					or_bits(word, bits);
+					word = k / 64;
+					bits = 0;
+				}
+
+				ins[k] = (uint32_t)x.in;
+				outs[k] = (uint32_t)x.out;
+				innovs[k] = (uint32_t)x.innov;
+				weights[k] = x.w;
+				bits |= (uint64_t)x.enabled << (k % 64);
+			}
+			if (!genome.connection_genes.empty()) or_bits(word, bits);
+
+			std::copy(BEG_END(genome.node_genes), BEG(nodes) + node_offsets[i]);
+			fingerprints[i] = ::fingerprint(genome);
+		}
+	});
+}
+
+void Gene_Pool::place(const Gene_Pool& part, size_t genome, size_t gene, size_t node) noexcept {
+	size_t n = part.size();
+	for (size_t i = 0; i < n; ++i) {
+		offsets[genome + i + 1] = (uint32_t)gene + part.offsets[i + 1];
+		node_offsets[genome + i + 1] = (uint32_t)node + part.node_offsets[i + 1];
+	}
+	std::copy(BEG_END(part.fingerprints), BEG(fingerprints) + genome);
+	std::copy(BEG_END(part.nodes), BEG(nodes) + node);
+
+	std::copy(BEG_END(part.ins), BEG(ins) + gene);
+	std::copy(BEG_END(part.outs), BEG(outs) + gene);
+	std::copy(BEG_END(part.innovs), BEG(innovs) + gene);
+	std::copy(BEG_END(part.weights), BEG(weights) + gene);
+
+	// The bits of part shifted to gene, every word of part spreads over two words at most.
+	size_t shift = gene % 64;
+	size_t n_genes = part.ins.size();
+	for (size_t w = 0; w < part.enabled.size(); ++w) {
+		uint64_t bits = part.enabled[w];
+		if (w == n_genes / 64) bits &= (1ull << (n_genes % 64)) - 1;
+
+		or_bits(gene / 64 + w, bits << shift);
+		if (shift && (bits >> (64 - shift))) or_bits(gene / 64 + w + 1, bits >> (64 - shift));
+	}
+}
+
+void Gene_Pool::unpack(size_t g, Genome& genome) const noexcept {
+	genome.n_inputs = n_inputs;
+	genome.n_outputs = n_outputs;
+
+	genome.connection_genes.resize(n_genes(g));
+	for (size_t k = offsets[g]; k < offsets[g + 1]; ++k) {
+		auto& x = genome.connection_genes[k - offsets[g]];
+		x.in = ins[k];
+		x.out = outs[k];
+		x.innov = innovs[k];
+		x.w = weights[k];
+		x.enabled = is_enabled(k);
+	}
+
+	genome.node_genes.assign(BEG(nodes) + node_offsets[g], BEG(nodes) + node_offsets[g + 1]);
+}
+
+void Gene_Pool::push_crossover(
+	const Gene_Pool& parents, size_t p1, size_t p2, pcg32_random_t& rng
+) noexcept {
+	if (offsets.empty()) clear();
+	n_inputs = parents.n_inputs;
+	n_outputs = parents.n_outputs;
+	mutation_weight_step = parents.mutation_weight_step;
+
+	// Both sides are sorted, a single merge pass finds every matching gene.
+	size_t j = parents.offsets[p2];
+	size_t j_end = parents.offsets[p2 + 1];
+	for (size_t i = parents.offsets[p1]; i < parents.offsets[p1 + 1]; ++i) {
+		uint32_t innov = parents.innovs[i];
+		while (j < j_end && parents.innovs[j] < innov) j++;
+
+		if (j < j_end && parents.innovs[j] == innov) {
+			// Node ids are local to a genome, a matching gene keeps the ends it has in parent1.
+			float w = (parents.weights[i] + parents.weights[j]) / 2;
+			bool first = randomf(rng) > .5;
+			push_connection(
+				parents.ins[i],
+				parents.outs[i],
+				innov,
+				first ? w : parents.weights[j],
+				parents.is_enabled(first ? i : j)
+			);
+		}
+		else push_connection(
+			parents.ins[i], parents.outs[i], innov, parents.weights[i], parents.is_enabled(i)
+		);
+	}
+	offsets.push_back((uint32_t)ins.size());
+
+	nodes.insert(
+		END(nodes),
+		BEG(parents.nodes) + parents.node_offsets[p1],
+		BEG(parents.nodes) + parents.node_offsets[p1 + 1]
+	);
+	node_offsets.push_back((uint32_t)nodes.size());
+	fingerprints.push_back(0);
+}
+
+void Gene_Pool::insert_connection(
+	size_t g, uint32_t in, uint32_t out, uint32_t innov, float w, bool x
+) noexcept {
+	size_t end = offsets[g + 1];
+	size_t k = std::lower_bound(BEG(innovs) + offsets[g], BEG(innovs) + end, innov) - BEG(innovs);
+
+	push_connection(in, out, innov, w, x);
+	offsets[g + 1]++;
+	if (k == end) return;
+
+	// Only the tail of the last genome moves.
+	std::rotate(BEG(ins) + k, BEG(ins) + end, BEG(ins) + end + 1);
+	std::rotate(BEG(outs) + k, BEG(outs) + end, BEG(outs) + end + 1);
+	std::rotate(BEG(innovs) + k, BEG(innovs) + end, BEG(innovs) + end + 1);
+	std::rotate(BEG(weights) + k, BEG(weights) + end, BEG(weights) + end + 1);
+	for (size_t i = end; i > k; --i) set_enabled(i, is_enabled(i - 1));
+	set_enabled(k, x);
+}
+
+void Gene_Pool::swap_connections(size_t a, size_t b) noexcept {
+	std::swap(ins[a], ins[b]);
+	std::swap(outs[a], outs[b]);
+	std::swap(innovs[a], innovs[b]);
+	std::swap(weights[a], weights[b]);
+
+	bool x = is_enabled(a);
+	set_enabled(a, is_enabled(b));
+	set_enabled(b, x);
+}
+
+uint32_t Gene_Pool::defer_request(size_t g, const Innovation_Request& request) noexcept {
+	size_t r = 0;
+	while (r < pending_genomes.size() && pending_genomes[pending_genomes.size() - 1 - r] == g) r++;
+
+	pending_innovations.push_back(request);
+	pending_genomes.push_back((uint32_t)g);
+	return (uint32_t)(Innovation_Request::Placeholder + 2 * r);
+}
+
+void Gene_Pool::number_pending_innovations() noexcept {
+	std::vector<size_t> numbers;
+
+	for (size_t begin = 0, end = 0; begin < pending_innovations.size(); begin = end) {
+		size_t g = pending_genomes[begin];
+		while (end < pending_genomes.size() && pending_genomes[end] == g) end++;
+
+		numbers.resize(2 * (end - begin));
+		ConnectionGene::Innovations.number(
+			pending_innovations.data() + begin, end - begin, numbers.data(), [&](size_t x) {
+				return has_innovation(g, x);
+			}
+		);
+
+		// The placeholders are the tail of the genome, sorted again once numbered.
+		size_t tail = offsets[g + 1];
+		while (tail > offsets[g] && innovs[tail - 1] >= Innovation_Request::Placeholder) tail--;
+		for (size_t k = tail; k < offsets[g + 1]; ++k)
+			innovs[k] = (uint32_t)numbers[innovs[k] - Innovation_Request::Placeholder];
+		for (size_t k = tail + 1; k < offsets[g + 1]; ++k)
+			for (size_t i = k; i > tail && innovs[i - 1] > innovs[i]; --i) swap_connections(i - 1, i);
+
+		fingerprints[g] = fingerprint(g);
+	}
+
+	pending_innovations.clear();
+	pending_genomes.clear();
+}
+
+void Gene_Pool::add_node_mutation(size_t g, pcg32_random_t& rng, bool deferred) noexcept {
+	if (!n_genes(g)) return;
+
+	size_t c = offsets[g] + random(rng, n_genes(g));
+	set_enabled(c, false);
+
+	NodeGene new_node;
+	new_node.id = n_nodes(g);
+	new_node.kind = NodeGene::Kind::Hidden;
+	new_node.func = NodeGene::Activation::Relu;
+
+	uint32_t in = ins[c];
+	uint32_t out = outs[c];
+	float w = weights[c];
+
+	size_t first_innov;
+	size_t second_innov;
+	if (deferred) {
+		first_innov = defer_request(g, { in, out, innovs[c], true });
+		second_innov = first_innov + 1;
+	}
+	else {
+		// A connection split a second time needs links of its own.
+		std::tie(first_innov, second_innov) = ConnectionGene::Innovations.split(innovs[c]);
+		if (has_innovation(g, first_innov)) {
+			first_innov = ConnectionGene::Innovations.fresh();
+			second_innov = ConnectionGene::Innovations.fresh();
+		}
+	}
+
+	nodes.push_back(new_node);
+	node_offsets[g + 1]++;
+	insert_connection(g, in, (uint32_t)new_node.id, (uint32_t)first_innov, 1, true);
+	insert_connection(g, (uint32_t)new_node.id, out, (uint32_t)second_innov, w, true);
+}
+
+void Gene_Pool::add_lstm_mutation(size_t g, pcg32_random_t& rng, bool deferred) noexcept {
+	size_t n = n_nodes(g);
+	add_node_mutation(g, rng, deferred);
+	if (n_nodes(g) == n) return;
+
+	nodes.back().kind = NodeGene::Kind::LSTM;
+	nodes.back().func = NodeGene::Activation::Linear;
+}
+
+void Gene_Pool::add_connection_mutation(size_t g, pcg32_random_t& rng, bool deferred) noexcept {
+	size_t n = n_nodes(g);
+	size_t in = random(rng, n);
+	size_t out = std::max(n_inputs, in) + random(rng, n - std::max(n_inputs, in));
+
+	auto& n_in = nodes[node_offsets[g] + in];
+	auto& n_out = nodes[node_offsets[g] + out];
+
+	if (in == out) return;
+	for (size_t k = offsets[g]; k < offsets[g + 1]; ++k)
+		if ((ins[k] == in && outs[k] == out) || (ins[k] == out && outs[k] == in)) return;
+
+	bool reversed =
+		(n_in.kind == NodeGene::Kind::Hidden && n_out.kind == NodeGene::Kind::Input) ||
+		(n_in.kind == NodeGene::Kind::Output && n_out.kind == NodeGene::Kind::Hidden) ||
+		(n_in.kind == NodeGene::Kind::Output && n_out.kind == NodeGene::Kind::LSTM) ||
+		(n_in.kind == NodeGene::Kind::Output && n_out.kind == NodeGene::Kind::Input);
+	if (reversed) std::swap(in, out);
+
+	size_t innov = deferred
+		? defer_request(g, { in, out, 0, false })
+		: ConnectionGene::Innovations.connection(in, out);
+	float w = randomf(rng) * 2 - 1;
+	insert_connection(g, (uint32_t)in, (uint32_t)out, (uint32_t)innov, w, true);
+}
+
+void Gene_Pool::connection_mutations(
+	size_t g, float weight, float disable, pcg32_random_t& rng
+) noexcept {
+	for (size_t k = offsets[g]; k < offsets[g + 1]; ++k) {
+		if (randomf(rng) < weight) weights[k] += randomnorm(rng, 0, mutation_weight_step);
+		if (randomf(rng) < disable) set_enabled(k, false);
+	}
+}
+
+void Gene_Pool::node_mutations(
+	size_t g, float activation, float weight, pcg32_random_t& rng
+) noexcept {
+	for (size_t i = node_offsets[g]; i < node_offsets[g + 1]; ++i) {
+		auto& node = nodes[i];
+		if (randomf(rng) < activation)
+			node.func = (NodeGene::Activation)random(rng, (uint32_t)NodeGene::Activation::Count);
+
+		if (node.kind != NodeGene::Kind::LSTM || randomf(rng) >= weight) continue;
+		auto& gates = node.gates;
+		for (float* x : {
+			&gates.input_w, &gates.input_b, &gates.forget_w, &gates.forget_b, &gates.output_w, &gates.output_b
+		})
+			*x += randomnorm(rng, 0, mutation_weight_step);
+	}
+}
+
+bool Gene_Pool::same(const Gene_Pool& a, size_t x, const Gene_Pool& b, size_t y) noexcept {
+	if (a.n_nodes(x) != b.n_nodes(y) || a.n_genes(x) != b.n_genes(y)) return false;
+
+	auto a_innovs = BEG(a.innovs) + a.offsets[x];
+	auto a_weights = BEG(a.weights) + a.offsets[x];
+	auto b_innovs = BEG(b.innovs) + b.offsets[y];
+	auto b_weights = BEG(b.weights) + b.offsets[y];
+	return
+		std::equal(a_innovs, a_innovs + a.n_genes(x), b_innovs) &&
+		std::equal(a_weights, a_weights + a.n_genes(x), b_weights);
+}
+
+float Gene_Pool::distance(
+	const Gene_Pool& a, size_t x, const Gene_Pool& b, size_t y, const Genome& coeffs
+) noexcept {
+	const uint32_t* a_innovs = a.innovs.data() + a.offsets[x];
+	const uint32_t* b_innovs = b.innovs.data() + b.offsets[y];
+	const float* a_weights = a.weights.data() + a.offsets[x];
+	const float* b_weights = b.weights.data() + b.offsets[y];
+	size_t n_a = a.n_genes(x);
+	size_t n_b = b.n_genes(y);
+
+	size_t N = std::max(n_a, n_b);
+	size_t disjoints = 0;
+	size_t excess = 0;
+	size_t avg_n = 0;
+	float avg_w = 0;
+
+	size_t i = 0;
+	size_t j = 0;
+	while (i < n_a && j < n_b) {
+		if (a_innovs[i] == b_innovs[j]) {
+			avg_w += std::abs(a_weights[i] - b_weights[j]);
+			avg_n++;
+			i++;
+			j++;
+		}
+		else if (a_innovs[i] > b_innovs[j]) {
+			disjoints++;
+			j++;
+		}
+		else {
+			disjoints++;
+			i++;
+		}
+	}
+
+	excess += n_a - i;
+	excess += n_b - j;
+
+	size_t a_nodes = a.n_nodes(x);
+	size_t b_nodes = b.n_nodes(y);
+	float mult =
+		1.f * std::max(a_nodes, b_nodes) /
+		1.f * std::min(a_nodes, b_nodes);
+
+	return mult * (coeffs.c1 * excess + coeffs.c2 * disjoints) / N + coeffs.c3 * avg_w / avg_n;
+}
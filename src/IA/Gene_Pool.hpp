@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Genome.hpp"
+
+// The genes of a list of genomes in flat arrays. Genome g owns the connection genes
+// [offsets[g], offsets[g + 1]), sorted by innovation like Genome::connection_genes, and the node
+// genes [node_offsets[g], node_offsets[g + 1]). Crossover, mutations, distances and network
+// compilation are single passes over those ranges.
+struct Gene_Pool {
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> ins;
+	std::vector<uint32_t> outs;
+	std::vector<uint32_t> innovs;
+	std::vector<float> weights;
+	// One bit per connection gene.
+	std::vector<uint64_t> enabled;
+
+	std::vector<uint32_t> node_offsets;
+	std::vector<NodeGene> nodes;
+
+	// Identifies what the distance depends on. Crossover and mutations leave it to the caller to
+	// refresh with fingerprint once the genome is done.
+	std::vector<uint64_t> fingerprints;
+
+	// Deferred structural mutations with their genome, in genome order.
+	std::vector<Innovation_Request> pending_innovations;
+	std::vector<uint32_t> pending_genomes;
+
+	// Every genome of a pool has the same inputs and outputs.
+	size_t n_inputs = 0;
+	size_t n_outputs = 0;
+
+	// Same as Genome::mutation_weight_step, for the weights and the gates.
+	float mutation_weight_step = 0.1f;
+
+	size_t size() const noexcept { return fingerprints.size(); }
+	size_t n_genes(size_t g) const noexcept { return offsets[g + 1] - offsets[g]; }
+	size_t n_nodes(size_t g) const noexcept { return node_offsets[g + 1] - node_offsets[g]; }
+
+	bool is_enabled(size_t k) const noexcept { return (enabled[k / 64] >> (k % 64)) & 1; }
+	void set_enabled(size_t k, bool x) noexcept;
+	bool has_innovation(size_t g, size_t innov) const noexcept;
+	uint64_t fingerprint(size_t g) const noexcept;
+
+	void clear() noexcept;
+	// n genomes of n_genes genes and n_nodes nodes in total, filled by place.
+	void resize(size_t n, size_t n_genes, size_t n_nodes) noexcept;
+	void push(const Genome& genome) noexcept;
+	void build(const std::vector<Genome>& genomes, size_t n_threads) noexcept;
+	// Copies every genome of part to the genome, gene and node indices given. Threads can place
+	// parts side by side in the same pool.
+	void place(const Gene_Pool& part, size_t genome, size_t gene, size_t node) noexcept;
+	// Only the genes, the rest of genome is left as is.
+	void unpack(size_t g, Genome& genome) const noexcept;
+
+	// Same as Genome::crossover, the offspring is pushed at the back. parents is another pool.
+	void push_crossover(const Gene_Pool& parents, size_t p1, size_t p2, pcg32_random_t& rng) noexcept;
+
+	// Same draws as the mutations of Genome. The structural ones only apply to the last genome,
+	// deferred they leave their numbers to number_pending_innovations.
+	void add_node_mutation(size_t g, pcg32_random_t& rng, bool deferred = false) noexcept;
+	void add_lstm_mutation(size_t g, pcg32_random_t& rng, bool deferred = false) noexcept;
+	void add_connection_mutation(size_t g, pcg32_random_t& rng, bool deferred = false) noexcept;
+	// Same as Genome::number_pending_innovations for every genome in order, their fingerprints
+	// refreshed.
+	void number_pending_innovations() noexcept;
+	// Every connection of g in one pass, each with its own chances of a weight mutation and of
+	// being disabled.
+	void connection_mutations(size_t g, float weight, float disable, pcg32_random_t& rng) noexcept;
+	// Every node of g in one pass, the gates mutate at the same rate as the weights.
+	void node_mutations(size_t g, float activation, float weight, pcg32_random_t& rng) noexcept;
+
+	// Same nodes count, innovations and weights, everything the distance and the fingerprint read.
+	static bool same(const Gene_Pool& a, size_t x, const Gene_Pool& b, size_t y) noexcept;
+	// Same as Genome::speciation_coeff, the coefficients coming from coeffs.
+	static float distance(
+		const Gene_Pool& a, size_t x, const Gene_Pool& b, size_t y, const Genome& coeffs
+	) noexcept;
+
+private:
+	// Keeps the last genome sorted like Genome::insert_connection.
+	void insert_connection(
+		size_t g, uint32_t in, uint32_t out, uint32_t innov, float w, bool enabled
+	) noexcept;
+	void push_connection(uint32_t in, uint32_t out, uint32_t innov, float w, bool enabled) noexcept;
+	void swap_connections(size_t a, size_t b) noexcept;
+	// Placeholder of the next request of the last genome g.
+	uint32_t defer_request(size_t g, const Innovation_Request& request) noexcept;
+	// ORs word into enabled[i] while other threads write the next words.
+	void or_bits(size_t i, uint64_t word) noexcept;
+};
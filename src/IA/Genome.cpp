@@ -1,11 +1,38 @@
 #include "Genome.hpp"
 #include "Random/Random.hpp"
+#include "macros.hpp"
 
 #include <algorithm>
+#include <tuple>
 
-void Genome::add_connection_mutation() noexcept {
-	size_t in = random(node_genes.size());
-	size_t out = std::max(n_inputs, in) + random(node_genes.size() - std::max(n_inputs, in));
+size_t Innovation_Registry::connection(size_t in, size_t out) noexcept {
+	uint64_t key = ((uint64_t)in << 32) | (uint64_t)out;
+
+	std::lock_guard lock(mutex);
+	auto [it, inserted] = connections.try_emplace(key, 0);
+	if (inserted) it->second = fresh();
+	return it->second;
+}
+
+std::pair<size_t, size_t> Innovation_Registry::split(size_t innov) noexcept {
+	std::lock_guard lock(mutex);
+	auto [it, inserted] = splits.try_emplace(innov, 0);
+	if (inserted) {
+		it->second = next.fetch_add(2);
+	}
+
+	return { it->second, it->second + 1 };
+}
+
+void Innovation_Registry::new_generation() noexcept {
+	std::lock_guard lock(mutex);
+	connections.clear();
+	splits.clear();
+}
+
+void Genome::add_connection_mutation(pcg32_random_t& rng, bool deferred) noexcept {
+	size_t in = random(rng, node_genes.size());
+	size_t out = std::max(n_inputs, in) + random(rng, node_genes.size() - std::max(n_inputs, in));
 
 	auto& n_in = node_genes[in];
 	auto& n_out = node_genes[out];
@@ -17,20 +44,68 @@ void Genome::add_connection_mutation() noexcept {
 	bool reversed =
 		(n_in.kind == NodeGene::Kind::Hidden && n_out.kind == NodeGene::Kind::Input) ||
 		(n_in.kind == NodeGene::Kind::Output && n_out.kind == NodeGene::Kind::Hidden) ||
+		(n_in.kind == NodeGene::Kind::Output && n_out.kind == NodeGene::Kind::LSTM) ||
 		(n_in.kind == NodeGene::Kind::Output && n_out.kind == NodeGene::Kind::Input);
 
 	ConnectionGene new_gene;
 	new_gene.in = reversed ? out : in;
 	new_gene.out = reversed ? in : out;
-	new_gene.innov = ConnectionGene::Innov_N++;
-	new_gene.w = randomf() * 2 - 1;
+	if (deferred) {
+		new_gene.innov = Innovation_Request::Placeholder + 2 * pending_innovations.size();
+		pending_innovations.push_back({ new_gene.in, new_gene.out, 0, false });
+	}
+	else new_gene.innov = ConnectionGene::Innovations.connection(new_gene.in, new_gene.out);
+	new_gene.w = randomf(rng) * 2 - 1;
 	new_gene.enabled = true;
 
-	connection_genes.push_back(new_gene);
+	insert_connection(new_gene);
 }
 
-void Genome::add_node_mutation() noexcept {
-	auto& connection = connection_genes[random(connection_genes.size())];
+void Genome::number_pending_innovations() noexcept {
+	if (pending_innovations.empty()) return;
+
+	size_t n = pending_innovations.size();
+	std::vector<size_t> numbers(2 * n);
+	ConnectionGene::Innovations.number(pending_innovations.data(), n, numbers.data(), [&](size_t x) {
+		return has_innovation(x);
+	});
+	pending_innovations.clear();
+
+	// The placeholders are the tail, their numbers are newer than the rest too.
+	size_t tail = connection_genes.size();
+	while (tail > 0 && connection_genes[tail - 1].innov >= Innovation_Request::Placeholder) tail--;
+	for (size_t i = tail; i < connection_genes.size(); ++i) {
+		auto& x = connection_genes[i];
+		x.innov = numbers[x.innov - Innovation_Request::Placeholder];
+	}
+	std::sort(BEG(connection_genes) + tail, END(connection_genes), [](auto& a, auto& b) {
+		return a.innov < b.innov;
+	});
+}
+
+bool Genome::has_innovation(size_t innov) const noexcept {
+	auto it = std::lower_bound(BEG_END(connection_genes), innov, [](auto& a, size_t b) {
+		return a.innov < b;
+	});
+	return it != END(connection_genes) && it->innov == innov;
+}
+
+void Genome::insert_connection(const ConnectionGene& gene) noexcept {
+	if (connection_genes.empty() || connection_genes.back().innov < gene.innov) {
+		connection_genes.push_back(gene);
+		return;
+	}
+
+	auto it = std::lower_bound(BEG_END(connection_genes), gene, [](auto& a, auto& b) {
+		return a.innov < b.innov;
+	});
+	connection_genes.insert(it, gene);
+}
+
+void Genome::add_node_mutation(pcg32_random_t& rng, bool deferred) noexcept {
+	if (connection_genes.empty()) return;
+
+	auto& connection = connection_genes[random(rng, connection_genes.size())];
 	connection.enabled = false;
 
 	NodeGene new_node;
@@ -38,23 +113,57 @@ void Genome::add_node_mutation() noexcept {
 	new_node.kind = NodeGene::Kind::Hidden;
 	new_node.func = NodeGene::Activation::Relu;
 
+	size_t first_innov;
+	size_t second_innov;
+	if (deferred) {
+		first_innov = Innovation_Request::Placeholder + 2 * pending_innovations.size();
+		second_innov = first_innov + 1;
+		pending_innovations.push_back({ connection.in, connection.out, connection.innov, true });
+	}
+	else {
+		// A connection split a second time needs links of its own.
+		std::tie(first_innov, second_innov) = ConnectionGene::Innovations.split(connection.innov);
+		if (has_innovation(first_innov)) {
+			first_innov = ConnectionGene::Innovations.fresh();
+			second_innov = ConnectionGene::Innovations.fresh();
+		}
+	}
+
 	ConnectionGene first;
 	first.in = connection.in;
 	first.out = new_node.id;
 	first.w = 1;
 	first.enabled = true;
-	first.innov = ConnectionGene::Innov_N++;
+	first.innov = first_innov;
 
 	ConnectionGene second;
 	second.in = new_node.id;
 	second.out = connection.out;
 	second.w = connection.w;
 	second.enabled = true;
-	second.innov = ConnectionGene::Innov_N++;
+	second.innov = second_innov;
 
 	node_genes.push_back(new_node);
-	connection_genes.push_back(first);
-	connection_genes.push_back(second);
+	insert_connection(first);
+	insert_connection(second);
+}
+
+// Same split as add_node_mutation with a memory cell in the middle.
+void Genome::add_lstm_mutation(pcg32_random_t& rng, bool deferred) noexcept {
+	size_t n_nodes = node_genes.size();
+	add_node_mutation(rng, deferred);
+	if (node_genes.size() == n_nodes) return;
+
+	node_genes.back().kind = NodeGene::Kind::LSTM;
+	node_genes.back().func = NodeGene::Activation::Linear;
+}
+
+void Genome::gates_mutation(size_t i, pcg32_random_t& rng) noexcept {
+	auto& gates = node_genes[i].gates;
+	for (float* x : {
+		&gates.input_w, &gates.input_b, &gates.forget_w, &gates.forget_b, &gates.output_w, &gates.output_b
+	})
+		*x += randomnorm(rng, 0, mutation_weight_step);
 }
 
 void Genome::del_node_mutation(size_t i) noexcept {
@@ -63,12 +172,12 @@ void Genome::del_node_mutation(size_t i) noexcept {
 	//}
 }
 
-void Genome::weight_mutation(size_t i) noexcept {
-	connection_genes[i].w += randomnorm(0, mutation_weight_step);
+void Genome::weight_mutation(size_t i, pcg32_random_t& rng) noexcept {
+	connection_genes[i].w += randomnorm(rng, 0, mutation_weight_step);
 }
 
-void Genome::activation_func_mutation(size_t i) noexcept {
-	auto x = (NodeGene::Activation)random((uint32_t)NodeGene::Activation::Count);
+void Genome::activation_func_mutation(size_t i, pcg32_random_t& rng) noexcept {
+	auto x = (NodeGene::Activation)random(rng, (uint32_t)NodeGene::Activation::Count);
 	node_genes[i].func = x;
 }
 
@@ -76,36 +185,49 @@ void Genome::remove_connection_mutation(size_t i) noexcept {
 	connection_genes[i].enabled = false;
 }
 
-Genome Genome::crossover(const Genome& parent1, const Genome& parent2) noexcept {
+Genome Genome::crossover(const Genome& parent1, const Genome& parent2, pcg32_random_t& rng) noexcept {
 	Genome offspring;
+	crossover(parent1, parent2, rng, offspring);
+	return offspring;
+}
+
+void Genome::crossover(
+	const Genome& parent1, const Genome& parent2, pcg32_random_t& rng, Genome& offspring
+) noexcept {
+	// A fresh genome keeping the capacity of the buffers.
+	auto connections = std::move(offspring.connection_genes);
+	auto nodes = std::move(offspring.node_genes);
+	auto pending = std::move(offspring.pending_innovations);
+	offspring = Genome{};
+	offspring.connection_genes = std::move(connections);
+	offspring.node_genes = std::move(nodes);
+	offspring.pending_innovations = std::move(pending);
+	offspring.pending_innovations.clear();
+
 	offspring.n_inputs = parent1.n_inputs;
 	offspring.n_outputs = parent1.n_outputs;
+	offspring.connection_genes.clear();
 	offspring.connection_genes.reserve(parent1.connection_genes.size());
-	offspring.node_genes = parent1.node_genes;
-
-	for (size_t i = 0; i < parent1.connection_genes.size(); ++i) {
-		auto x = parent1.connection_genes[i];
-
-		bool matching = false;
-		const ConnectionGene* other = nullptr;
-		for (size_t j = 0; j < parent2.connection_genes.size(); ++j) {
-			auto& y = parent2.connection_genes[j];
-
-			if (x.innov < y.innov) break;
-			if (x.innov == y.innov) {
-				matching = true;
-				other = &y;
-				x.w = (x.w + y.w) / 2;
-				break;
-			}
-		}
+	offspring.node_genes.assign(BEG_END(parent1.node_genes));
 
-		if (matching) offspring.connection_genes.push_back(randomf() > .5 ? x : *other);
-		else          offspring.connection_genes.push_back(x);
+	// Both sides are sorted, a single merge pass finds every matching gene.
+	auto& others = parent2.connection_genes;
+	size_t j = 0;
+	for (auto x : parent1.connection_genes) {
+		while (j < others.size() && others[j].innov < x.innov) j++;
+
+		if (j < others.size() && others[j].innov == x.innov) {
+			auto& y = others[j];
+			x.w = (x.w + y.w) / 2;
+
+			// Node ids are local to a genome, a matching gene keeps the ends it has in parent1.
+			auto gene = randomf(rng) > .5 ? x : y;
+			gene.in = x.in;
+			gene.out = x.out;
+			offspring.connection_genes.push_back(gene);
+		}
+		else offspring.connection_genes.push_back(x);
 	}
-
-
-	return offspring;
 }
 
 float Genome::speciation_coeff(const Genome& a, const Genome& b) noexcept {
@@ -152,7 +274,7 @@ float Genome::speciation_coeff(const Genome& a, const Genome& b) noexcept {
 	return mult * (a.c1 * excess + a.c2 * disjoints) / N + a.c3 * avg_w / avg_n;
 }
 
-Genome Genome::generate(size_t n_inputs, size_t n_outputs) noexcept {
+Genome Genome::generate(size_t n_inputs, size_t n_outputs, pcg32_random_t& rng) noexcept {
 	Genome g;
 //
 	g.n_inputs = n_inputs;
@@ -177,8 +299,8 @@ Genome Genome::generate(size_t n_inputs, size_t n_outputs) noexcept {
 	for (size_t i = 0; i < n_inputs; ++i) {
 		for (size_t j = 0; j < n_outputs; ++j) {
 			ConnectionGene connec;
-			connec.innov = ConnectionGene::Innov_N++;
-			connec.w = randomf() * 2 - 1;
+			connec.innov = ConnectionGene::Innovations.connection(i, j + n_inputs);
+			connec.w = randomf(rng) * 2 - 1;
 			connec.enabled = true;
 			connec.in = i;
 			connec.out = j + n_inputs;
@@ -218,84 +340,84 @@ Genome Genome::generate(size_t n_inputs, size_t n_outputs) noexcept {
 		//connec.out = 3;
 		//connec.w = -.5f;
 		////connec.w = randomf() * 2 - 1;
-		//connec.innov = ConnectionGene::Innov_N++;
+		//connec.innov = ConnectionGene::Innovations.fresh();
 		//genome.connection_genes.push_back(connec);
 //
 		//connec.in = 1;
 		//connec.out = 3;
 		//connec.w = 1;
 		////connec.w = randomf() * 2 - 1;
-		//connec.innov = ConnectionGene::Innov_N++;
+		//connec.innov = ConnectionGene::Innovations.fresh();
 		//genome.connection_genes.push_back(connec);
 //
 		//connec.in = 2;
 		//connec.out = 3;
 		//connec.w = 1;
 		////connec.w = randomf() * 2 - 1;
-		//connec.innov = ConnectionGene::Innov_N++;
+		//connec.innov = ConnectionGene::Innovations.fresh();
 		//genome.connection_genes.push_back(connec);
 
 		connec.in = 4;
 		connec.out = 3;
 		connec.w = -2;
 		//connec.w = randomf() * 2 - 1;
-		connec.innov = ConnectionGene::Innov_N++;
+		connec.innov = ConnectionGene::Innovations.fresh();
 		genome.connection_genes.push_back(connec);
 
 		connec.in = 0;
 		connec.out = 4;
 		connec.w = -1.5f;
 		//connec.w = randomf() * 2 - 1;
-		connec.innov = ConnectionGene::Innov_N++;
+		connec.innov = ConnectionGene::Innovations.fresh();
 		genome.connection_genes.push_back(connec);
 
 		connec.in = 1;
 		connec.out = 4;
 		connec.w = 1;
 		//connec.w = randomf() * 2 - 1;
-		connec.innov = ConnectionGene::Innov_N++;
+		connec.innov = ConnectionGene::Innovations.fresh();
 		genome.connection_genes.push_back(connec);
 
 		connec.in = 2;
 		connec.out = 4;
 		connec.w = 1;
 		//connec.w = randomf() * 2 - 1;
-		connec.innov = ConnectionGene::Innov_N++;
+		connec.innov = ConnectionGene::Innovations.fresh();
 		genome.connection_genes.push_back(connec);
 
 		connec.in = 0;
 		connec.out = 5;
 		connec.w = -1.5f;
 		//connec.w = randomf() * 2 - 1;
-		connec.innov = ConnectionGene::Innov_N++;
+		connec.innov = ConnectionGene::Innovations.fresh();
 		genome.connection_genes.push_back(connec);
 
 		connec.in = 1;
 		connec.out = 5;
 		connec.w = 1;
 		//connec.w = randomf() * 2 - 1;
-		connec.innov = ConnectionGene::Innov_N++;
+		connec.innov = ConnectionGene::Innovations.fresh();
 		genome.connection_genes.push_back(connec);
 
 		connec.in = 2;
 		connec.out = 5;
 		connec.w = 1;
 		//connec.w = randomf() * 2 - 1;
-		connec.innov = ConnectionGene::Innov_N++;
+		connec.innov = ConnectionGene::Innovations.fresh();
 		genome.connection_genes.push_back(connec);
 
 		connec.in = 5;
 		connec.out = 3;
 		connec.w = 1;
 		//connec.w = randomf() * 2 - 1;
-		connec.innov = ConnectionGene::Innov_N++;
+		connec.innov = ConnectionGene::Innovations.fresh();
 		genome.connection_genes.push_back(connec);
 		
 		connec.in = 0;
 		connec.out = 3;
 		connec.w = 1;
 		//connec.w = randomf() * 2 - 1;
-		connec.innov = ConnectionGene::Innov_N++;
+		connec.innov = ConnectionGene::Innovations.fresh();
 		//genome.connection_genes.push_back(connec);
 
 		genome.n_inputs = 3;
@@ -1,11 +1,76 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <vector>
 #include <set>
 #include <string>
+#include <unordered_map>
+
+#include "Random/Random.hpp"
+
+// A structural mutation made while breeding in parallel. Its links take placeholders above every
+// real number, in the order the mutations are made, and get their numbers once every offspring is
+// done so the numbers do not depend on the order the threads run in.
+struct Innovation_Request {
+	// Request r of a genome stands for Placeholder + 2 * r, the second link of a split for
+	// Placeholder + 2 * r + 1. Real numbers stay below it.
+	static constexpr size_t Placeholder = 0xC0000000;
+
+	// A new connection in -> out, or the split of the connection innov which can be a placeholder.
+	size_t in;
+	size_t out;
+	size_t innov;
+	bool split;
+};
+
+// Hands out innovation numbers. During a generation the same structural mutation gets the same
+// numbers in every genome, new_generation forgets them. Safe to use from several threads.
+struct Innovation_Registry {
+	std::atomic<size_t> next = 0;
+
+	std::mutex mutex;
+	std::unordered_map<uint64_t, size_t> connections;
+	// First of the two numbers of the links replacing a split connection.
+	std::unordered_map<size_t, size_t> splits;
+
+	size_t fresh() noexcept { return next++; }
+	size_t connection(size_t in, size_t out) noexcept;
+	// The links in -> node then node -> out replacing the connection innov.
+	std::pair<size_t, size_t> split(size_t innov) noexcept;
+	void new_generation() noexcept;
+
+	// Numbers the n requests of a genome in order, numbers[2 * r] and numbers[2 * r + 1] replacing
+	// the placeholders of request r. has tells if the genome already had a number before them.
+	template<typename Has>
+	void number(const Innovation_Request* requests, size_t n, size_t* numbers, Has&& has) noexcept {
+		for (size_t r = 0; r < n; ++r) {
+			auto& x = requests[r];
+			if (!x.split) {
+				numbers[2 * r] = connection(x.in, x.out);
+				numbers[2 * r + 1] = numbers[2 * r];
+				continue;
+			}
+
+			size_t innov = x.innov;
+			if (innov >= Innovation_Request::Placeholder) innov = numbers[innov - Innovation_Request::Placeholder];
+
+			// A connection split a second time needs links of its own.
+			auto [first, second] = split(innov);
+			bool taken = has(first);
+			for (size_t i = 0; i < 2 * r; ++i) taken |= numbers[i] == first;
+			if (taken) {
+				first = fresh();
+				second = fresh();
+			}
+			numbers[2 * r] = first;
+			numbers[2 * r + 1] = second;
+		}
+	}
+};
 
 struct ConnectionGene {
-	static inline auto Innov_N = 0;
+	static inline Innovation_Registry Innovations;
 
 	size_t in;
 	size_t out;
@@ -30,9 +95,21 @@ struct NodeGene {
 		Count
 	} kind;
 	size_t id;
+
+	// Only read on LSTM nodes, every gate is sigmoid(w * x + b) of the weighted sum x of the
+	// node's links and func is the activation of the candidate entering the cell.
+	struct Gates {
+		float input_w = 1;
+		float input_b = 0;
+		float forget_w = 1;
+		float forget_b = 1;
+		float output_w = 1;
+		float output_b = 0;
+	} gates;
 };
 
 struct Genome {
+	// Sorted by innovation number, crossover and speciation walk two genomes side by side.
 	std::vector<ConnectionGene> connection_genes;
 	std::vector<NodeGene> node_genes;
 
@@ -52,16 +129,35 @@ struct Genome {
 
 	bool marked = false;
 
-	void add_node_mutation() noexcept;
-	void weight_mutation(size_t i) noexcept;
+	// Structural mutations waiting for their numbers, their links sit at the back of
+	// connection_genes with placeholders.
+	std::vector<Innovation_Request> pending_innovations;
+
+	// Keeps connection_genes sorted, a new innovation goes straight to the back.
+	void insert_connection(const ConnectionGene& gene) noexcept;
+	bool has_innovation(size_t innov) const noexcept;
+
+	// The mutations draw from rng, one stream per reproduction thread. Deferred structural
+	// mutations leave their numbers to number_pending_innovations.
+	void add_node_mutation(pcg32_random_t& rng, bool deferred = false) noexcept;
+	void add_lstm_mutation(pcg32_random_t& rng, bool deferred = false) noexcept;
+	void gates_mutation(size_t i, pcg32_random_t& rng) noexcept;
+	void weight_mutation(size_t i, pcg32_random_t& rng) noexcept;
 	void del_node_mutation(size_t i) noexcept;
-	void add_connection_mutation() noexcept;
-	void activation_func_mutation(size_t i) noexcept;
+	void add_connection_mutation(pcg32_random_t& rng, bool deferred = false) noexcept;
+	// Gives the deferred mutations their numbers, the genomes of a generation going one after
+	// the other in a fixed order.
+	void number_pending_innovations() noexcept;
+	void activation_func_mutation(size_t i, pcg32_random_t& rng) noexcept;
 	void remove_connection_mutation(size_t i) noexcept;
 
 	std::string to_string() noexcept;
 
-	static Genome generate(size_t n_inputs, size_t n_outputs) noexcept;
+	static Genome generate(size_t n_inputs, size_t n_outputs, pcg32_random_t& rng) noexcept;
 	static float speciation_coeff(const Genome& a, const Genome& b) noexcept;
-	static Genome crossover(const Genome& parent1, const Genome& parent2) noexcept;
+	static Genome crossover(const Genome& parent1, const Genome& parent2, pcg32_random_t& rng) noexcept;
+	// Same, writing over offspring and reusing its buffers.
+	static void crossover(
+		const Genome& parent1, const Genome& parent2, pcg32_random_t& rng, Genome& offspring
+	) noexcept;
 };
@@ -4,143 +4,517 @@
 #include <cmath>
 
 #include "macros.hpp"
+#include "Fast_Math.hpp"
 
-float Network::Node::apply(float x, Network::Node::Activation act) noexcept {
-	//return x > 0 ? 1 : 0;
-	return 1 / (1 + std::expf(-x));
+using namespace fast_math;
+
+float Network::Node::apply(float x, Network::Node::Activation act, bool fast) noexcept {
 	switch(act) {
-		case Node::Activation::Linear:
-			return x;
+		case Node::Activation::Sig:
+			return fast ? fast_sigmoid(x) : 1 / (1 + std::exp(-x));
+		case Node::Activation::Tanh:
+			return fast ? fast_tanh(x) : std::tanh(x);
 		case Node::Activation::Relu:
 			return x > 0 ? x : 0;
-		case Node::Activation::Sig:
-			return 1 / (1 + std::expf(-x));
 		case Node::Activation::Sign:
-			return x > 0 ? 1 : 0;
-		default: return x;//return x + 1 > 0 ? x : -1;
+			return x > 0 ? 1.f : 0.f;
+		case Node::Activation::Cos:
+			return fast ? fast_cos(x) : std::cos(x);
+		case Node::Activation::Sin:
+			return fast ? fast_sin(x) : std::sin(x);
+		// Aggregators, the work is done while reading the links.
+		case Node::Activation::Linear:
+		case Node::Activation::Mult:
+		case Node::Activation::Add:
+		default:
+			return x;
 	}
 }
 
-Network Network::generate(Genome genome) noexcept {
-	Network net;
-
-	struct Temp {
-		Node n;
-		size_t i;
-	};
-	std::vector<Temp> temps;
-
-	for (auto& x : genome.node_genes) {
-		Node node;
-		node.kind = x.kind == NodeGene::Kind::LSTM ? Node::Kind::LSTM : Node::Kind::Simple;
-
-		switch (x.func) {
-		case NodeGene::Activation::Relu:
-			node.func = Node::Activation::Relu;
+void Network::Node::apply(float* x, size_t n, Network::Node::Activation act, bool fast) noexcept {
+	// One loop per function so each one vectorizes on its own.
+	switch(act) {
+		case Node::Activation::Sig:
+			if (fast) {
+				for (size_t i = 0; i < n; ++i) x[i] = clamp_exp(-x[i]);
+				for (size_t i = 0; i < n; ++i) x[i] = 1 / (1 + exp_unclamped(x[i]));
+			}
+			else for (size_t i = 0; i < n; ++i) x[i] = 1 / (1 + std::exp(-x[i]));
 			break;
-		case NodeGene::Activation::Linear:
-			node.func = Node::Activation::Linear;
+		case Node::Activation::Tanh:
+			if (fast) {
+				for (size_t i = 0; i < n; ++i) x[i] = clamp_exp(-2 * x[i]);
+				for (size_t i = 0; i < n; ++i) x[i] = 2 / (1 + exp_unclamped(x[i])) - 1;
+			}
+			else for (size_t i = 0; i < n; ++i) x[i] = std::tanh(x[i]);
+			break;
+		case Node::Activation::Relu:
+			for (size_t i = 0; i < n; ++i) x[i] = x[i] > 0 ? x[i] : 0;
+			break;
+		case Node::Activation::Sign:
+			for (size_t i = 0; i < n; ++i) x[i] = x[i] > 0 ? 1.f : 0.f;
 			break;
-		case NodeGene::Activation::Sig:
-			node.func = Node::Activation::Sig;
+		case Node::Activation::Cos:
+			if (fast) for (size_t i = 0; i < n; ++i) x[i] = fast_cos(x[i]);
+			else for (size_t i = 0; i < n; ++i) x[i] = std::cos(x[i]);
 			break;
-		case NodeGene::Activation::Sign:
-			node.func = Node::Activation::Sign;
+		case Node::Activation::Sin:
+			if (fast) for (size_t i = 0; i < n; ++i) x[i] = fast_sin(x[i]);
+			else for (size_t i = 0; i < n; ++i) x[i] = std::sin(x[i]);
 			break;
 		default:
-			node.func = Node::Activation::Relu;
 			break;
-		}
+	}
+}
 
-		temps.push_back({ node, x.id });
+Network::Node Network::make_node(const NodeGene& gene) noexcept {
+	Node node;
+	node.kind = gene.kind == NodeGene::Kind::LSTM ? Node::Kind::LSTM : Node::Kind::Simple;
 
-		if (x.kind == NodeGene::Kind::Input) net.n_inputs++;
-		if (x.kind == NodeGene::Kind::Output) net.n_outputs++;
+	switch (gene.func) {
+	case NodeGene::Activation::Relu:
+		node.func = Node::Activation::Relu;
+		break;
+	case NodeGene::Activation::Linear:
+		node.func = Node::Activation::Linear;
+		break;
+	case NodeGene::Activation::Sig:
+		node.func = Node::Activation::Sig;
+		break;
+	case NodeGene::Activation::Sign:
+		node.func = Node::Activation::Sign;
+		break;
+	default:
+		node.func = Node::Activation::Relu;
+		break;
 	}
 
-	std::sort(BEG_END(temps), [](const auto& a, const auto& b) { return a.i < b.i; });
-	net.nodes.reserve(temps.size());
-	net.links.resize(temps.size());
+	return node;
+}
+
+void Network::Plan::clear() noexcept {
+	order.clear();
+	funcs.clear();
+	offsets.clear();
+	sources.clear();
+	weights.clear();
+	groups.clear();
+	output_slots.clear();
+	cells.clear();
+}
+
+size_t Network::Compiler::compile(const Genome& genome, Plan& plan, bool keep_delayed) noexcept {
+	size_t n = genome.node_genes.size();
+	size_t n_inputs = genome.n_inputs;
 
-	for (auto& x : temps) net.nodes.push_back(x.n);
+	// Incoming links per node, inputs are set by the caller so their links are dropped.
+	in_offsets.assign(n + 1, 0);
+	for (auto& x : genome.connection_genes)
+		if (x.enabled && x.out >= n_inputs) in_offsets[x.out + 1]++;
+	for (size_t i = 0; i < n; ++i) in_offsets[i + 1] += in_offsets[i];
+
+	in_links.resize(in_offsets[n]);
+	cursor.assign(BEG(in_offsets), BEG(in_offsets) + n);
+	for (auto& x : genome.connection_genes)
+		if (x.enabled && x.out >= n_inputs)
+			in_links[cursor[x.out]++] = { (uint32_t)x.in, x.w };
+
+	return compile_links(genome.node_genes.data(), n, n_inputs, genome.n_outputs, plan, keep_delayed);
+}
 
-	for (auto& x : genome.connection_genes) {
-		if (x.enabled)
-			net.links[x.out].push_back({ (int)x.in, x.w });
+size_t Network::Compiler::compile(const Gene_Pool& pool, size_t g, Plan& plan, bool keep_delayed) noexcept {
+	size_t n = pool.n_nodes(g);
+	size_t n_inputs = pool.n_inputs;
+	size_t begin = pool.offsets[g];
+	size_t end = pool.offsets[g + 1];
+
+	// Same two passes over the arrays of the pool.
+	in_offsets.assign(n + 1, 0);
+	for (size_t k = begin; k < end; ++k)
+		if (pool.is_enabled(k) && pool.outs[k] >= n_inputs) in_offsets[pool.outs[k] + 1]++;
+	for (size_t i = 0; i < n; ++i) in_offsets[i + 1] += in_offsets[i];
+
+	in_links.resize(in_offsets[n]);
+	cursor.assign(BEG(in_offsets), BEG(in_offsets) + n);
+	for (size_t k = begin; k < end; ++k)
+		if (pool.is_enabled(k) && pool.outs[k] >= n_inputs)
+			in_links[cursor[pool.outs[k]]++] = { pool.ins[k], pool.weights[k] };
+
+	auto nodes = pool.nodes.data() + pool.node_offsets[g];
+	return compile_links(nodes, n, n_inputs, pool.n_outputs, plan, keep_delayed);
+}
+
+size_t Network::Compiler::compile_links(
+	const NodeGene* nodes, size_t n, size_t n_inputs, size_t n_outputs, Plan& plan, bool keep_delayed
+) noexcept {
+	// Depth first from the outputs, a node is placed after everything it reads. A link to a node
+	// still on the stack closes a cycle and becomes delayed.
+	enum State : uint8_t { Unvisited, Open, Done };
+	states.assign(n, Unvisited);
+	for (size_t i = 0; i < n_inputs; ++i) states[i] = Done;
+
+	delayed.assign(in_links.size(), false);
+	topo.clear();
+
+	for (size_t o = n_inputs; o < n_inputs + n_outputs; ++o) {
+		if (states[o] != Unvisited) continue;
+		stack.push_back({ (uint32_t)o, in_offsets[o] });
+		states[o] = Open;
+
+		while (!stack.empty()) {
+			auto& top = stack.back();
+			if (top.next_link == in_offsets[top.node + 1]) {
+				states[top.node] = Done;
+				topo.push_back(top.node);
+				stack.pop_back();
+				continue;
+			}
+
+			size_t l = top.next_link++;
+			uint32_t in = in_links[l].in;
+			if (states[in] == Open) delayed[l] = true;
+			if (states[in] != Unvisited) continue;
+
+			states[in] = Open;
+			stack.push_back({ in, in_offsets[in] });
+		}
+	}
+
+	// The layer of a node is its longest path from the inputs, delayed links aside.
+	depths.assign(n, 0);
+	for (auto i : topo) {
+		uint32_t depth = 1;
+		for (size_t l = in_offsets[i]; l < in_offsets[i + 1]; ++l)
+			if (!delayed[l]) depth = std::max(depth, depths[in_links[l].in] + 1);
+		depths[i] = depth;
 	}
 
+	auto func = [&](uint32_t i) {
+		auto& gene = nodes[i];
+		return gene.kind == NodeGene::Kind::LSTM ? Node::Activation::LSTM : make_node(gene).func;
+	};
+	std::stable_sort(BEG_END(topo), [&](uint32_t a, uint32_t b) {
+		if (depths[a] != depths[b]) return depths[a] < depths[b];
+		return func(a) < func(b);
+	});
+
+	size_t n_slots = n_inputs + topo.size();
+	slots.assign(n, 0);
+	for (size_t i = 0; i < n_inputs; ++i) slots[i] = (uint32_t)i;
+	for (size_t k = 0; k < topo.size(); ++k) slots[topo[k]] = (uint32_t)(n_inputs + k);
+
+	size_t n_delayed = 0;
+	for (size_t k = 0; k < topo.size(); ++k) {
+		auto i = topo[k];
+		auto f = func(i);
+
+		plan.order.push_back(i);
+		plan.funcs.push_back(f);
+		if (f == Node::Activation::LSTM)
+			plan.cells.push_back({ make_node(nodes[i]).func, nodes[i].gates });
+
+		for (size_t l = in_offsets[i]; l < in_offsets[i + 1]; ++l) {
+			n_delayed += delayed[l];
+			if (delayed[l] && !keep_delayed) continue;
+
+			plan.sources.push_back(slots[in_links[l].in] + (delayed[l] ? (uint32_t)n_slots : 0));
+			plan.weights.push_back(in_links[l].w);
+		}
+		plan.offsets.push_back((uint32_t)plan.sources.size());
+
+		uint32_t slot = (uint32_t)(n_inputs + k);
+		bool same_group = k > 0 && depths[topo[k - 1]] == depths[i] && plan.groups.back().func == f;
+		if (same_group) plan.groups.back().end = slot + 1;
+		else            plan.groups.push_back({ slot, slot + 1, f });
+	}
+
+	for (size_t o = n_inputs; o < n_inputs + n_outputs; ++o) plan.output_slots.push_back(slots[o]);
+
+	return n_delayed;
+}
+
+Network::Plan_View Network::view() const noexcept {
+	Plan_View v;
+	v.funcs = plan.funcs.data();
+	v.offsets = plan.offsets.data();
+	v.sources = plan.sources.data();
+	v.weights = plan.weights.data();
+	v.groups = plan.groups.data();
+	v.output_slots = plan.output_slots.data();
+	v.cells = plan.cells.data();
+	v.n_inputs = n_inputs;
+	v.n_outputs = n_outputs;
+	v.n_order = plan.order.size();
+	v.n_groups = plan.groups.size();
+	v.n_slots = n_slots;
+	v.n_cells = plan.cells.size();
+	return v;
+}
+
+Network::State Network::make_state(size_t n_instances) const noexcept {
+	State s;
+	s.n_instances = n_instances;
+	s.previous.resize(n_slots * n_instances, 0.f);
+	s.cells.resize(plan.cells.size() * n_instances, 0.f);
+	return s;
+}
+
+void Network::State::reset() noexcept {
+	std::fill(BEG_END(previous), 0.f);
+	std::fill(BEG_END(cells), 0.f);
+}
+
+void Network::State::reset(size_t instance) noexcept {
+	for (size_t i = instance; i < previous.size(); i += n_instances) previous[i] = 0;
+	for (size_t i = instance; i < cells.size(); i += n_instances) cells[i] = 0;
+}
+
+Network Network::generate(const Genome& genome) noexcept {
+	Network net;
+
+	// Node ids are their index in the genome.
+	net.nodes.resize(genome.node_genes.size());
+	for (auto& x : genome.node_genes) net.nodes[x.id] = make_node(x);
+
+	net.n_inputs = genome.n_inputs;
+	net.n_outputs = genome.n_outputs;
+
+	Compiler compiler;
+	net.plan.offsets.push_back(0);
+	net.n_delayed = compiler.compile(genome, net.plan, true);
+	net.n_slots = net.n_inputs + net.plan.order.size();
+
+	net.values.resize(net.n_slots, 0);
+	net.state = net.make_state(1);
 	return net;
 }
 
-std::vector<float> Network::compute(const std::vector<float>& inputs) noexcept {	
-	for (size_t i = 0; i < n_inputs; ++i) {
-		auto& x = nodes[i];
-		x.activation = inputs[i];
-		x.activesum = inputs[i];
-		x.activated = true;
+std::vector<float> Network::compute(const std::vector<float>& inputs) noexcept {
+	float* current = values.data();
+	for (size_t i = 0; i < n_inputs; ++i) current[i] = inputs[i];
+
+	State_View s;
+	if (keep_state) {
+		s.previous = state.previous.data();
+		s.cells = state.cells.data();
+		s.update = true;
 	}
 
-	bool flag = false;
-	size_t i = 0;
-	do {
-		flag = false;
+	// A single row, the columns are the values themselves.
+	if (grouped) run_groups(view(), s, current, 1, 1, fast_activations);
+	else         run_per_node(view(), s, current, 1, 1, fast_activations);
 
+	if (n_delayed && keep_state) std::copy(current, current + n_slots, BEG(state.previous));
 
-		for (size_t i = n_inputs; i < nodes.size(); ++i) {
-			auto& x = nodes[i];
+	std::vector<float> outputs;
+	outputs.reserve(n_outputs);
 
-			x.activesum = 0;
-			x.activated = true;
-			for (auto& l : links[i]) if (nodes[l.in].activated) {
-				x.activesum += nodes[l.in].activation * l.w;
-			} else {
-				x.activated = false;
-			}
+	for (auto slot : plan.output_slots) outputs.push_back(current[slot]);
+
+	return outputs;
+}
+
+void Network::compute(const float* inputs, size_t n_rows, float* outputs) noexcept {
+	size_t tile = std::min(Batch_Tile, n_rows);
+	batch_values.resize(n_slots * tile);
+	auto v = view();
+
+	State_View s;
+	s.previous = state.previous.data();
+	s.cells = state.cells.data();
+
+	for (size_t beg = 0; beg < n_rows; beg += tile) {
+		size_t rows = std::min(tile, n_rows - beg);
+		float* columns = batch_values.data();
+
+		for (size_t i = 0; i < n_inputs; ++i) {
+			float* column = columns + i * tile;
+			for (size_t r = 0; r < rows; ++r) column[r] = inputs[(beg + r) * n_inputs + i];
+		}
+
+		if (grouped) run_groups(v, s, columns, tile, rows, fast_activations);
+		else         run_per_node(v, s, columns, tile, rows, fast_activations);
+
+		for (size_t o = 0; o < n_outputs; ++o) {
+			const float* column = columns + plan.output_slots[o] * tile;
+			for (size_t r = 0; r < rows; ++r) outputs[(beg + r) * n_outputs + o] = column[r];
+		}
+	}
+}
+
+void Network::step(State& state, const float* inputs, float* outputs) noexcept {
+	size_t n = state.n_instances;
+	size_t tile = std::min(Batch_Tile, n);
+	batch_values.resize(n_slots * tile);
+	auto v = view();
+
+	for (size_t beg = 0; beg < n; beg += tile) {
+		size_t rows = std::min(tile, n - beg);
+		float* columns = batch_values.data();
+
+		for (size_t i = 0; i < n_inputs; ++i) {
+			float* column = columns + i * tile;
+			for (size_t r = 0; r < rows; ++r) column[r] = inputs[(beg + r) * n_inputs + i];
+		}
+
+		// Every instance is a row of its own state.
+		State_View s;
+		s.previous = state.previous.data() + beg;
+		s.cells = state.cells.data() + beg;
+		s.stride = n;
+		s.row_stride = 1;
+		s.update = true;
+
+		if (grouped) run_groups(v, s, columns, tile, rows, fast_activations);
+		else         run_per_node(v, s, columns, tile, rows, fast_activations);
+
+		for (size_t o = 0; o < n_outputs; ++o) {
+			const float* column = columns + plan.output_slots[o] * tile;
+			for (size_t r = 0; r < rows; ++r) outputs[(beg + r) * n_outputs + o] = column[r];
 		}
 
-		for (size_t i = n_inputs; i < nodes.size(); ++i) {
-			auto& x = nodes[i];
-			if (!x.activated) {
-				flag = true;
+		// Only read by later steps, every link of this one is done.
+		if (!n_delayed) continue;
+		for (size_t slot = 0; slot < n_slots; ++slot) {
+			const float* column = columns + slot * tile;
+			float* previous = state.previous.data() + slot * n + beg;
+			for (size_t r = 0; r < rows; ++r) previous[r] = column[r];
+		}
+	}
+}
+
+namespace {
+	// Weighted sum, or product for Mult, of the links of position k into its column.
+	void aggregate(
+		const Network::Plan_View& plan,
+		size_t k,
+		bool product,
+		const Network::State_View& state,
+		float* columns,
+		size_t stride,
+		size_t rows
+	) noexcept {
+		float* __restrict sum = columns + (plan.n_inputs + k) * stride;
+		uint32_t beg = plan.offsets[k];
+		uint32_t end = plan.offsets[k + 1];
+
+		// A Mult node without any link outputs 0.
+		float init = product && beg < end ? 1.f : 0.f;
+		for (size_t r = 0; r < rows; ++r) sum[r] = init;
+
+		for (size_t l = beg; l < end; ++l) {
+			float w = plan.weights[l];
+			uint32_t source = plan.sources[l];
+
+			if (source >= plan.n_slots && state.previous && state.row_stride) {
+				const float* x = state.previous + (source - plan.n_slots) * state.stride;
+				size_t step = state.row_stride;
+				if (product) for (size_t r = 0; r < rows; ++r) sum[r] *= x[r * step] * w;
+				else         for (size_t r = 0; r < rows; ++r) sum[r] += x[r * step] * w;
+				continue;
+			}
+			if (source >= plan.n_slots) {
+				float x = state.previous ? state.previous[(source - plan.n_slots) * state.stride] * w : 0.f;
+				if (product) for (size_t r = 0; r < rows; ++r) sum[r] *= x;
+				else         for (size_t r = 0; r < rows; ++r) sum[r] += x;
 				continue;
 			}
 
-			x.activation = Node::apply(x.activesum, x.func);
+			const float* __restrict x = columns + source * stride;
+			if (product) for (size_t r = 0; r < rows; ++r) sum[r] *= x[r] * w;
+			else         for (size_t r = 0; r < rows; ++r) sum[r] += x[r] * w;
 		}
+	}
+}
 
-	} while(flag && i++ < 20);
+void Network::run_groups(
+	const Plan_View& plan, const State_View& state, float* columns, size_t stride, size_t rows, bool fast
+) noexcept {
+	size_t cell = 0;
+	for (size_t g = 0; g < plan.n_groups; ++g) {
+		auto& group = plan.groups[g];
+		bool product = group.func == Node::Activation::Mult;
 
-	//bool at_least_one = false;
-	//while (!at_least_one) {
-	//	at_least_one = true;
+		for (size_t slot = group.begin; slot < group.end; ++slot)
+			aggregate(plan, slot - plan.n_inputs, product, state, columns, stride, rows);
 
-	//	for (size_t i = n_inputs; i < nodes.size(); i++) {
-	//		auto& x = nodes[i];
-	//		if (x.fully_fed) continue;
+		size_t n = group.end - group.begin;
+		if (group.func == Node::Activation::LSTM) {
+			run_cells(plan.cells + cell, n, cell, state, columns + group.begin * stride, stride, rows, fast);
+			cell += n;
+			continue;
+		}
 
-	//		x.fully_fed = true;
-	//		for (auto& l : links[i]) {
-	//			if (l.in < 0) continue;
-	//			if (!nodes[l.in].fully_fed) continue;
-	//			x.fully_fed = false;
-	//			at_least_one = false;
+		// The columns of a group are contiguous, a full tile goes through a single call. The
+		// padding rows of a partial tile are left out.
+		float* x = columns + group.begin * stride;
+		if (rows == stride) Node::apply(x, n * stride, group.func, fast);
+		else for (size_t j = 0; j < n; ++j) Node::apply(x + j * stride, rows, group.func, fast);
+	}
+}
 
-	//			x.activation += nodes[l.in].activation * l.w;
-	//			l.in *= -1;
-	//			l.in -= 1;
-	//		}
+void Network::run_per_node(
+	const Plan_View& plan, const State_View& state, float* columns, size_t stride, size_t rows, bool fast
+) noexcept {
+	size_t cell = 0;
+	for (size_t k = 0; k < plan.n_order; ++k) {
+		auto func = plan.funcs[k];
+		float* x = columns + (plan.n_inputs + k) * stride;
+		aggregate(plan, k, func == Node::Activation::Mult, state, columns, stride, rows);
 
-	//		if (x.fully_fed) x.activation = Node::apply(x.activation, x.func);
-	//	}
-	//}
+		if (func == Node::Activation::LSTM) run_cells(plan.cells + cell, 1, cell, state, x, stride, rows, fast);
+		else                                Node::apply(x, rows, func, fast);
+		cell += func == Node::Activation::LSTM;
+	}
+}
 
-	//for (auto& x : links) for (auto& y : x) y.in = -(1 + y.in);
+void Network::run_cells(
+	const Cell* cells,
+	size_t n,
+	size_t first,
+	const State_View& state,
+	float* x,
+	size_t stride,
+	size_t rows,
+	bool fast
+) noexcept {
+	constexpr size_t Chunk = Batch_Tile;
+	float in[Chunk];
+	float forget[Chunk];
+	float out[Chunk];
+	float candidate[Chunk];
+	float memory[Chunk];
 
-	std::vector<float> outputs;
-	outputs.reserve(n_outputs);
+	for (size_t j = 0; j < n; ++j) {
+		auto& gates = cells[j].gates;
+		float* cell = state.cells ? state.cells + (first + j) * state.stride : nullptr;
 
-	for (size_t i = n_inputs; i < n_inputs + n_outputs; ++i) outputs.push_back(nodes[i].activation);
-	for (auto& x : nodes) { x.activated = false; x.activation = 0; x.activesum = 0; }
+		for (size_t beg = 0; beg < rows; beg += Chunk) {
+			size_t m = std::min(Chunk, rows - beg);
+			float* __restrict sum = x + j * stride + beg;
 
-	return outputs;
+			for (size_t r = 0; r < m; ++r) {
+				in[r] = gates.input_w * sum[r] + gates.input_b;
+				forget[r] = gates.forget_w * sum[r] + gates.forget_b;
+				out[r] = gates.output_w * sum[r] + gates.output_b;
+				candidate[r] = sum[r];
+			}
+			Node::apply(in, m, Node::Activation::Sig, fast);
+			Node::apply(forget, m, Node::Activation::Sig, fast);
+			Node::apply(out, m, Node::Activation::Sig, fast);
+			Node::apply(candidate, m, cells[j].func, fast);
+
+			// A shared cell is the same for every row.
+			size_t step = state.row_stride;
+			for (size_t r = 0; r < m; ++r) {
+				float previous = cell ? cell[(beg + r) * step] : 0.f;
+				memory[r] = forget[r] * previous + in[r] * candidate[r];
+			}
+			if (cell && state.update)
+				for (size_t r = 0; r < m; ++r) cell[(beg + r) * step] = memory[r];
+
+			Node::apply(memory, m, Node::Activation::Tanh, fast);
+			for (size_t r = 0; r < m; ++r) sum[r] = out[r] * memory[r];
+		}
+	}
 }
@@ -1,17 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <stdint.h>
+
+#include "Gene_Pool.hpp"
 #include "Genome.hpp"
 
 struct Network {
-	struct Link {
-		int in;
-		float w;
-	};
-	
 	struct Node {
-		float activation = 0;
-		float activesum = 0;
-
 		enum class Activation : std::uint8_t {
 			Sig = 0,
 			Linear,
@@ -22,6 +18,8 @@ struct Network {
 			Sin,
 			Mult,
 			Add,
+			// Only in plans, the node steps a Cell.
+			LSTM,
 			Count
 		} func;
 
@@ -31,17 +29,182 @@ struct Network {
 			Count
 		} kind;
 
-		bool activated = false;
-		static float apply(float x, Node::Activation act) noexcept;
+		// Mult and Add only change how the inputs are aggregated, see run_plan. fast swaps the libm
+		// calls for the approximations of Fast_Math.hpp.
+		static float apply(float x, Node::Activation act, bool fast = false) noexcept;
+		static void apply(float* x, size_t n, Node::Activation act, bool fast = false) noexcept;
+	};
+
+	// Gates of an LSTM node over the weighted sum x of its links:
+	//   cell   = sigmoid(forget_w * x + forget_b) * previous cell + sigmoid(input_w * x + input_b) * func(x)
+	//   output = sigmoid(output_w * x + output_b) * tanh(cell)
+	struct Cell {
+		Node::Activation func;
+		NodeGene::Gates gates;
+	};
+
+	// Nodes of the same layer never read each other, inside a layer they are sorted by activation
+	// so each group of slots [begin, end) runs through a single kernel.
+	struct Group {
+		uint32_t begin;
+		uint32_t end;
+		Node::Activation func;
+	};
+
+	// Execution plan. Values live in slots, the inputs first then every node feeding an output
+	// layer by layer, order[k] being the node of slot n_inputs + k. The links of that slot are
+	// [offsets[k], offsets[k + 1]) in sources and weights.
+	// A source below n_slots is read from the current pass, a link closing a cycle instead reads
+	// source - n_slots, the value of that slot at the end of the previous pass.
+	// LSTM nodes have a single group func, their cells follow the order of their slots.
+	struct Plan {
+		std::vector<uint32_t> order;
+		std::vector<Node::Activation> funcs;
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> sources;
+		std::vector<float> weights;
+		std::vector<Group> groups;
+		std::vector<uint32_t> output_slots;
+		std::vector<Cell> cells;
+
+		void clear() noexcept;
+	};
+
+	// The part of a Plan belonging to one network, offsets are the only absolute indices.
+	struct Plan_View {
+		const Node::Activation* funcs;
+		const uint32_t* offsets;
+		const uint32_t* sources;
+		const float* weights;
+		const Group* groups;
+		const uint32_t* output_slots;
+		const Cell* cells;
+
+		size_t n_inputs;
+		size_t n_outputs;
+		size_t n_order;
+		size_t n_groups;
+		size_t n_slots;
+		size_t n_cells;
+	};
+
+	// Recurrent state read by a run. Row r reads the previous value of slot s at
+	// previous[s * stride + r * row_stride] and the LSTM cell c at cells[c * stride + r * row_stride],
+	// a row_stride of 0 shares one state between every row. A missing buffer reads 0 and cells are
+	// only written back when update is set.
+	struct State_View {
+		const float* previous = nullptr;
+		float* cells = nullptr;
+		size_t stride = 1;
+		size_t row_stride = 0;
+		bool update = false;
+	};
+
+	// Memory of n_instances copies of a network, e.g. one per seat, kept from one step to the
+	// next until reset, e.g. at the start of a hand. Stored in columns so the instances step
+	// together, the previous value of slot s for instance i is previous[s * n_instances + i].
+	struct State {
+		size_t n_instances = 0;
+		std::vector<float> previous;
+		std::vector<float> cells;
+
+		void reset() noexcept;
+		void reset(size_t instance) noexcept;
 	};
 
 	std::vector<Node> nodes;
-	std::vector<std::vector<Link>> links;
 
 	size_t n_inputs = 0;
 	size_t n_outputs = 0;
 
+	Plan plan;
+	size_t n_slots = 0;
+	size_t n_delayed = 0;
+
+	// Scratch of the single row compute.
+	std::vector<float> values;
+	// Single instance state of compute.
+	State state;
+
+	// When set, delayed links and cells read the previous call to compute instead of 0.
+	bool keep_state = false;
+	bool fast_activations = false;
+	// One activation call per group instead of per node, see bench_grouping. Off by default, it
+	// shows no consistent gain on the narrow graphs evolved so far.
+	bool grouped = false;
+
+	bool recurrent() const noexcept { return n_delayed > 0 || !plan.cells.empty(); }
+	void reset_state() noexcept { state.reset(); }
+	Plan_View view() const noexcept;
+	State make_state(size_t n_instances) const noexcept;
+
+	// Scratch of the batched compute, one column of at most Batch_Tile rows per slot.
+	static constexpr size_t Batch_Tile = 256;
+	std::vector<float> batch_values;
+
 	std::vector<float> compute(const std::vector<float>& inputs) noexcept;
+	// inputs is n_rows x n_inputs and outputs n_rows x n_outputs, both row major. Every row is
+	// independent, delayed links and cells read the saved state without updating it.
+	void compute(const float* inputs, size_t n_rows, float* outputs) noexcept;
+	// One step of every instance of state, row i of inputs and outputs belongs to instance i.
+	void step(State& state, const float* inputs, float* outputs) noexcept;
+
+	// Run a plan over rows, columns holds one column of stride floats per slot with the inputs
+	// already set.
+	static void run_groups(
+		const Plan_View& plan, const State_View& state, float* columns, size_t stride, size_t rows, bool fast
+	) noexcept;
+	static void run_per_node(
+		const Plan_View& plan, const State_View& state, float* columns, size_t stride, size_t rows, bool fast
+	) noexcept;
+	// Steps the n LSTM nodes whose sums are the columns from x on, their cells being state's
+	// cells from first on.
+	static void run_cells(
+		const Cell* cells,
+		size_t n,
+		size_t first,
+		const State_View& state,
+		float* x,
+		size_t stride,
+		size_t rows,
+		bool fast
+	) noexcept;
+
+	// Builds execution plans, the scratch is reused from one genome to the next.
+	struct Compiler {
+		struct In_Link {
+			uint32_t in;
+			float w;
+		};
+		struct Frame {
+			uint32_t node;
+			uint32_t next_link;
+		};
+
+		std::vector<uint32_t> in_offsets;
+		std::vector<uint32_t> cursor;
+		std::vector<In_Link> in_links;
+		std::vector<uint8_t> states;
+		std::vector<uint8_t> delayed;
+		std::vector<Frame> stack;
+		std::vector<uint32_t> topo;
+		std::vector<uint32_t> depths;
+		std::vector<uint32_t> slots;
+
+		// Appends the plan of genome, slots stay local to the genome and the offsets continue
+		// from sources.size(). Returns the number of delayed links, they are only appended when
+		// keep_delayed is set.
+		size_t compile(const Genome& genome, Plan& plan, bool keep_delayed) noexcept;
+		// Same for genome g of pool.
+		size_t compile(const Gene_Pool& pool, size_t g, Plan& plan, bool keep_delayed) noexcept;
+
+	private:
+		// The rest of compile once in_offsets and in_links hold the enabled links of the nodes.
+		size_t compile_links(
+			const NodeGene* nodes, size_t n, size_t n_inputs, size_t n_outputs, Plan& plan, bool keep_delayed
+		) noexcept;
+	};
 
-	static Network generate(Genome genome) noexcept;
-};
\ No newline at end of file
+	static Node make_node(const NodeGene& gene) noexcept;
+	static Network generate(const Genome& genome) noexcept;
+};
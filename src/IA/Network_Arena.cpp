@@ -0,0 +1,140 @@
+#include "Network_Arena.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "macros.hpp"
+
+Network::Plan_View Network_Arena::view(size_t i) const noexcept {
+	auto& entry = entries[i];
+
+	Network::Plan_View v;
+	v.funcs = plan.funcs.data() + entry.order_offset;
+	v.offsets = plan.offsets.data() + entry.order_offset;
+	v.sources = plan.sources.data();
+	v.weights = plan.weights.data();
+	v.groups = plan.groups.data() + entry.group_offset;
+	v.output_slots = plan.output_slots.data() + entry.output_offset;
+	v.cells = plan.cells.data() + entry.cell_offset;
+	v.n_inputs = n_inputs;
+	v.n_outputs = n_outputs;
+	v.n_order = entry.n_order;
+	v.n_groups = entry.n_groups;
+	v.n_slots = n_inputs + entry.n_order;
+	v.n_cells = (i + 1 < entries.size() ? entries[i + 1].cell_offset : plan.cells.size()) - entry.cell_offset;
+	return v;
+}
+
+void Network_Arena::reset(size_t n_genomes, size_t total_nodes, size_t total_links) noexcept {
+	entries.clear();
+	plan.clear();
+	max_slots = 0;
+
+	entries.reserve(n_genomes);
+	plan.order.reserve(total_nodes);
+	plan.funcs.reserve(total_nodes);
+	plan.offsets.reserve(total_nodes + 1);
+	plan.sources.reserve(total_links);
+	plan.weights.reserve(total_links);
+	plan.groups.reserve(total_nodes);
+	plan.output_slots.reserve(n_genomes * n_outputs);
+
+	plan.offsets.push_back(0);
+}
+
+Network_Arena::Entry Network_Arena::open_entry() const noexcept {
+	Entry entry;
+	entry.order_offset = (uint32_t)plan.order.size();
+	entry.group_offset = (uint32_t)plan.groups.size();
+	entry.output_offset = (uint32_t)plan.output_slots.size();
+	entry.cell_offset = (uint32_t)plan.cells.size();
+	return entry;
+}
+
+void Network_Arena::close_entry(Entry entry) noexcept {
+	entry.n_order = (uint32_t)plan.order.size() - entry.order_offset;
+	entry.n_groups = (uint32_t)plan.groups.size() - entry.group_offset;
+
+	max_slots = std::max(max_slots, n_inputs + entry.n_order);
+	entries.push_back(entry);
+}
+
+void Network_Arena::build(const std::vector<Genome>& genomes) noexcept {
+	n_inputs = genomes.empty() ? 0 : genomes.front().n_inputs;
+	n_outputs = genomes.empty() ? 0 : genomes.front().n_outputs;
+
+	size_t total_nodes = 0;
+	size_t total_links = 0;
+	for (auto& x : genomes) {
+		total_nodes += x.node_genes.size();
+		total_links += x.connection_genes.size();
+	}
+	reset(genomes.size(), total_nodes, total_links);
+
+	for (auto& x : genomes) {
+		auto entry = open_entry();
+		compiler.compile(x, plan, false);
+		close_entry(entry);
+	}
+}
+
+void Network_Arena::build(const Gene_Pool& pool) noexcept {
+	n_inputs = pool.n_inputs;
+	n_outputs = pool.n_outputs;
+	reset(pool.size(), pool.nodes.size(), pool.ins.size());
+
+	for (size_t g = 0; g < pool.size(); ++g) {
+		auto entry = open_entry();
+		compiler.compile(pool, g, plan, false);
+		close_entry(entry);
+	}
+}
+
+void Network_Arena::compute(const float* inputs, size_t n_rows, float* outputs) noexcept {
+	if (entries.empty() || !n_rows) return;
+
+	size_t threads = n_threads ? n_threads : std::max(1u, std::thread::hardware_concurrency());
+	threads = std::max((size_t)1, std::min(threads, (entries.size() + batch_size - 1) / batch_size));
+
+	size_t tile = std::min(Network::Batch_Tile, n_rows);
+	std::atomic<size_t> next_entry = 0;
+
+	auto work = [&](size_t) {
+		std::vector<float> columns(max_slots * tile);
+
+		while (true) {
+			size_t begin = next_entry.fetch_add(batch_size, std::memory_order_relaxed);
+			if (begin >= entries.size()) break;
+			size_t end = std::min(begin + batch_size, entries.size());
+
+			for (size_t e = begin; e < end; ++e) {
+				auto v = view(e);
+				float* out = outputs + e * n_rows * n_outputs;
+
+				for (size_t beg = 0; beg < n_rows; beg += tile) {
+					size_t rows = std::min(tile, n_rows - beg);
+
+					for (size_t i = 0; i < n_inputs; ++i) {
+						float* column = columns.data() + i * tile;
+						for (size_t r = 0; r < rows; ++r) column[r] = inputs[(beg + r) * n_inputs + i];
+					}
+
+					if (grouped) Network::run_groups(v, {}, columns.data(), tile, rows, fast_activations);
+					else         Network::run_per_node(v, {}, columns.data(), tile, rows, fast_activations);
+
+					for (size_t o = 0; o < n_outputs; ++o) {
+						const float* column = columns.data() + v.output_slots[o] * tile;
+						for (size_t r = 0; r < rows; ++r) out[(beg + r) * n_outputs + o] = column[r];
+					}
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (size_t i = 1; i < threads; ++i) workers.emplace_back(work, i);
+	work(0);
+	for (auto& x : workers) x.join();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Network.hpp"
+
+// The plans of every genome of a generation packed in a shared Plan, evaluated together over the
+// same dataset. Evaluation is stateless, links closing a cycle and LSTM cells read 0.
+struct Network_Arena {
+	struct Entry {
+		// Into plan.order and plan.funcs, the links of its first slot start at offsets[order_offset].
+		uint32_t order_offset;
+		uint32_t n_order;
+		uint32_t group_offset;
+		uint32_t n_groups;
+		uint32_t output_offset;
+		uint32_t cell_offset;
+	};
+
+	std::vector<Entry> entries;
+	Network::Plan plan;
+
+	size_t n_inputs = 0;
+	size_t n_outputs = 0;
+	size_t max_slots = 0;
+
+	bool fast_activations = false;
+	// Same as Network::grouped.
+	bool grouped = false;
+	// 0 uses every hardware thread.
+	size_t n_threads = 0;
+	// Genomes handed to a worker at a time.
+	size_t batch_size = 256;
+
+	size_t size() const noexcept { return entries.size(); }
+	Network::Plan_View view(size_t i) const noexcept;
+
+	// Every genome must have the same number of inputs and outputs.
+	void build(const std::vector<Genome>& genomes) noexcept;
+	void build(const Gene_Pool& pool) noexcept;
+	// inputs is n_rows x n_inputs row major, outputs is size() x n_rows x n_outputs.
+	void compute(const float* inputs, size_t n_rows, float* outputs) noexcept;
+
+private:
+	Network::Compiler compiler;
+
+	void reset(size_t n_genomes, size_t total_nodes, size_t total_links) noexcept;
+	// An entry is opened before its plan is compiled and closed after.
+	Entry open_entry() const noexcept;
+	void close_entry(Entry entry) noexcept;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Splits [0, n) in batches handed to the threads as they get free. 0 threads uses every hardware
+// thread.
+template<typename F>
+void parallel_for(size_t n, size_t n_threads, F&& f, size_t batch_size = 1024) noexcept {
+	size_t threads = n_threads ? n_threads : std::max(1u, std::thread::hardware_concurrency());
+	threads = std::max((size_t)1, std::min(threads, (n + batch_size - 1) / batch_size));
+
+	std::atomic<size_t> next = 0;
+	auto work = [&] {
+		while (true) {
+			size_t begin = next.fetch_add(batch_size, std::memory_order_relaxed);
+			if (begin >= n) break;
+			f(begin, std::min(begin + batch_size, n));
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (size_t i = 1; i < threads; ++i) workers.emplace_back(work);
+	work();
+	for (auto& x : workers) x.join();
+}
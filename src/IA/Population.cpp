@@ -1,5 +1,6 @@
 #include "Population.hpp"
 
+#include "Parallel.hpp"
 #include "Random/Random.hpp"
 #include "macros.hpp"
 
@@ -8,160 +9,316 @@
 #include <algorithm>
 
 void Population::selection() noexcept {
-	float fitness_sum = 0;
-	for (size_t i = 0; i < genomes.size(); ++i) {
-		size_t n = 0;
-		for (auto& specie : species) {
-			if (std::find(BEG_END(specie), i) != END(specie)) continue;
-			n = specie.size();
-			break;
-		}
+	constexpr size_t None = SIZE_MAX;
+	size_t n = genomes.size();
 
-		float divisor = std::max(n, (size_t)20);
-		divisor = std::powf(divisor, speciation_size_inverse_power);
-		float mult = 2 * 2 / (1 + std::expf(-age_influence * genomes[i].age));
+	// Dense genome -> specie index, a genome speciate has not seen yet has none.
+	specie_of.assign(n, None);
+	for (size_t s = 0; s < species.size(); ++s) for (auto i : species[s]) specie_of[i] = s;
 
-		genomes[i].adjusted_fitness = mult * genomes[i].fitness / divisor;
-		
+	parallel_for(n, n_threads, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			size_t specie_size = specie_of[i] == None ? 0 : species[specie_of[i]].size();
 
-		fitness_sum += genomes[i].adjusted_fitness;
-	}
+			float divisor = std::max(specie_size, (size_t)20);
+			divisor = std::powf(divisor, speciation_size_inverse_power);
+			float mult = 2 * 2 / (1 + std::expf(-age_influence * genomes[i].age));
+
+			genomes[i].adjusted_fitness = mult * genomes[i].fitness / divisor;
+		}
+	});
 
 	float to_select = (1 - to_kill) * (1 - to_kill);
 
-	auto lamb = [&](auto a, auto b) {
+	// The best of every specie survive, each specie sorted on its own.
+	keep.assign(n, false);
+	for (size_t i = 0; i < n; ++i) keep[i] = specie_of[i] == None;
+
+	auto by_fitness = [&](size_t a, size_t b) {
 		return genomes[a].adjusted_fitness > genomes[b].adjusted_fitness;
 	};
-	for (auto& specie : species) {
-		std::sort(BEG_END(specie), lamb);
-		specie.resize((size_t)std::floor(to_select * specie.size()));
-	}
-	for (size_t i = 0; i < species.size(); ++i) {
-		if (species[i].empty()) {
-			species[i] = species.back();
-			species.pop_back();
+	parallel_for(species.size(), n_threads, [&](size_t begin, size_t end) {
+		for (size_t s = begin; s < end; ++s) {
+			auto& specie = species[s];
+			size_t n_kept = (size_t)std::floor(to_select * specie.size());
+			std::partial_sort(specie.begin(), specie.begin() + n_kept, specie.end(), by_fitness);
+			specie.resize(n_kept);
+			for (auto i : specie) keep[i] = true;
 		}
+	}, 16);
+
+	// Survivors compacted in place, then the global cut.
+	size_t n_survivors = 0;
+	for (size_t i = 0; i < n; ++i) {
+		if (!keep[i]) {
+			recycled.push_back(std::move(genomes[i]));
+			continue;
+		}
+		if (n_survivors != i) genomes[n_survivors] = std::move(genomes[i]);
+		specie_of[n_survivors] = specie_of[i];
+		n_survivors++;
 	}
-
-	auto pred = [&, i = 0](const Genome& x) mutable {
-		bool flag = false;
-		for (auto& specie : species) for (auto& j : specie) if (i == j) { flag = true; goto next; };
-		next:
-		i++;
-		return flag;
-	};
-	genomes.erase(std::remove_if(BEG_END(genomes), pred), END(genomes));
-	std::sort(
-		BEG_END(genomes),
-		[](const auto& a, const auto& b) { return a.adjusted_fitness > b.adjusted_fitness; }
-	);
-	genomes.resize((size_t)(to_select * genomes.size()));
-
-	//for (size_t i = 0; i < to_select; ++i) {
-	//	float prob = 0;
-	//	size_t selec = 0;
-//
-	//	do {
-	//		selec = random(genomes.size());
-	//		prob = genomes[i].adjusted_fitness / fitness_sum;
-	//	} while (randomf() > prob);
-//
-	//	selected.push_back(genomes[selec]);
-	//	fitness_sum -= genomes[selec].adjusted_fitness;
-	//	genomes[selec] = genomes.back();
-	//	genomes.pop_back();
-	//}
-
-	//genomes.swap(selected);
+	genomes.resize(n_survivors);
+	specie_of.resize(n_survivors);
+
+	order.resize(n_survivors);
+	for (size_t i = 0; i < n_survivors; ++i) order[i] = i;
+	size_t n_selected = (size_t)(to_select * n_survivors);
+	std::partial_sort(order.begin(), order.begin() + n_selected, order.end(), by_fitness);
+	for (size_t k = n_selected; k < order.size(); ++k) recycled.push_back(std::move(genomes[order[k]]));
+	order.resize(n_selected);
+
+	selected.clear();
+	selected.reserve(population_size);
+	for (auto i : order) selected.push_back(std::move(genomes[i]));
+	genomes.swap(selected);
+
+	// Species point at the new indices, emptied ones stay until speciate drops them with their
+	// representative.
+	for (auto& specie : species) specie.clear();
+	for (size_t i = 0; i < order.size(); ++i)
+		if (specie_of[order[i]] != None) species[specie_of[order[i]]].push_back(i);
 }
 
 void Population::reproduction() noexcept {
 	size_t parent_size = genomes.size();
-	size_t to_birth = population_size - genomes.size();
-
-	float fitness_sum = 0;
-	for (auto& x : genomes) fitness_sum += x.adjusted_fitness;
-
-	for (size_t i = 0; i < to_birth; ++i) {
-		auto r1 = randomf() * fitness_sum;
-		auto r2 = randomf() * fitness_sum;
-
-		size_t p1 = 0;
-		size_t p2 = 0;
-
-		for (size_t j = 0; j < parent_size; ++j) {
-			if (r1 < 0 && r2 < 0) break;
-
-			auto& x = genomes[j];
-			r1 -= x.adjusted_fitness;
-			r2 -= x.adjusted_fitness;
+	size_t to_birth = population_size > parent_size ? population_size - parent_size : 0;
+
+	// Structural mutations of this generation share their innovations.
+	ConnectionGene::Innovations.new_generation();
+
+	// Parents drawn in proportion to their adjusted fitness.
+	fitnesses.resize(parent_size);
+	for (size_t i = 0; i < parent_size; ++i) fitnesses[i] = genomes[i].adjusted_fitness;
+	parents.build(fitnesses.data(), parent_size);
+
+	// Every batch has its own stream, the offsprings only depend on the seed and the generation.
+	// generate already used the seed itself.
+	constexpr size_t Batch_Size = 256;
+	uint64_t generation_seed = seed + ++n_reproductions;
+
+	// Offsprings are written in place over the genomes killed by selection, their genes reuse
+	// the buffers.
+	if (!parent_size) to_birth = 0;
+	genomes.reserve(parent_size + to_birth);
+	for (size_t o = 0; o < to_birth; ++o) {
+		if (recycled.empty()) {
+			genomes.emplace_back();
+			continue;
+		}
+		genomes.push_back(std::move(recycled.back()));
+		recycled.pop_back();
+	}
 
-			if (r1 < 0) {
-				p1 = j;
-				continue;
+	parallel_for(to_birth, n_threads, [&](size_t begin, size_t end) {
+		auto rng = pcg32_seed(generation_seed, begin / Batch_Size);
+
+		for (size_t o = begin; o < end; ++o) {
+			size_t p1 = parents.sample(rng);
+			size_t p2 = parents.sample(rng);
+			if (genomes[p1].adjusted_fitness > genomes[p2].adjusted_fitness) std::swap(p1, p2);
+
+			auto& it = genomes[parent_size + o];
+			Genome::crossover(genomes[p1], genomes[p2], rng, it);
+			if (randomf(rng) < mutation_add_node) it.add_node_mutation(rng, true);
+			if (randomf(rng) < mutation_add_lstm) it.add_lstm_mutation(rng, true);
+			if (randomf(rng) < mutation_add_connection) it.add_connection_mutation(rng, true);
+			for (size_t i = 0; i < it.connection_genes.size(); ++i){
+				if (randomf(rng) < mutation_weight) it.weight_mutation(i, rng);
+				if (randomf(rng) < mutation_del_connection) it.remove_connection_mutation(i);
 			}
-
-			if (r2 < 0) {
-				p2 = j;
-				continue;
+			for (size_t i = 0; i < it.node_genes.size(); ++i) {
+				if (randomf(rng) < mutation_activation) it.activation_func_mutation(i, rng);
+				if (it.node_genes[i].kind == NodeGene::Kind::LSTM && randomf(rng) < mutation_weight)
+					it.gates_mutation(i, rng);
 			}
 		}
+	}, Batch_Size);
 
-		if (genomes[p1].adjusted_fitness > genomes[p2].adjusted_fitness) std::swap(p1, p2);
+	// In offspring order, the same numbers whatever thread bred what.
+	for (size_t o = 0; o < to_birth; ++o) genomes[parent_size + o].number_pending_innovations();
 
-		auto it = Genome::crossover(genomes[p1], genomes[p2]);
-		if (randomf() < mutation_add_node) it.add_node_mutation();
-		if (randomf() < mutation_add_connection) it.add_connection_mutation();
-		for (size_t i = 0; i < it.connection_genes.size(); ++i){
-			if (randomf() < mutation_weight) it.weight_mutation(i);
-			if (randomf() < mutation_del_connection) it.remove_connection_mutation(i);
-		}
-		for (size_t i = 0; i < it.node_genes.size(); ++i)
-			if (randomf() < mutation_activation) it.activation_func_mutation(i);
+	for (auto& x : genomes) x.age++;
+}
 
-		genomes.push_back(it);
+void Population::breed(
+	const Gene_Pool& pool, const float* adjusted_fitnesses, Gene_Pool& offsprings
+) noexcept {
+	size_t parent_size = pool.size();
+	size_t to_birth = parent_size && population_size > parent_size ? population_size - parent_size : 0;
+
+	ConnectionGene::Innovations.new_generation();
+	parents.build(adjusted_fitnesses, parent_size);
+
+	// Same streams and draws as reproduction, each batch breeds in its own pool.
+	constexpr size_t Batch_Size = 256;
+	uint64_t generation_seed = seed + ++n_reproductions;
+
+	size_t n_batches = (to_birth + Batch_Size - 1) / Batch_Size;
+	if (batch_pools.size() < n_batches) batch_pools.resize(n_batches);
+
+	parallel_for(to_birth, n_threads, [&](size_t begin, size_t end) {
+		auto rng = pcg32_seed(generation_seed, begin / Batch_Size);
+		auto& batch = batch_pools[begin / Batch_Size];
+		batch.clear();
+
+		for (size_t o = begin; o < end; ++o) {
+			size_t p1 = parents.sample(rng);
+			size_t p2 = parents.sample(rng);
+			if (adjusted_fitnesses[p1] > adjusted_fitnesses[p2]) std::swap(p1, p2);
+
+			batch.push_crossover(pool, p1, p2, rng);
+			size_t g = batch.size() - 1;
+			if (randomf(rng) < mutation_add_node) batch.add_node_mutation(g, rng, true);
+			if (randomf(rng) < mutation_add_lstm) batch.add_lstm_mutation(g, rng, true);
+			if (randomf(rng) < mutation_add_connection) batch.add_connection_mutation(g, rng, true);
+			batch.connection_mutations(g, mutation_weight, mutation_del_connection, rng);
+			batch.node_mutations(g, mutation_activation, mutation_weight, rng);
+			batch.fingerprints[g] = batch.fingerprint(g);
+		}
+	}, Batch_Size);
+
+	// Batches in order then their genomes in order, the numbers of reproduction.
+	for (size_t b = 0; b < n_batches; ++b) batch_pools[b].number_pending_innovations();
+
+	// The batches side by side.
+	size_t n_genes = 0;
+	size_t n_nodes = 0;
+	std::vector<size_t> gene_offsets(n_batches);
+	std::vector<size_t> node_offsets(n_batches);
+	for (size_t b = 0; b < n_batches; ++b) {
+		gene_offsets[b] = n_genes;
+		node_offsets[b] = n_nodes;
+		n_genes += batch_pools[b].ins.size();
+		n_nodes += batch_pools[b].nodes.size();
 	}
 
-	for (auto& x : genomes) x.age++;
+	offsprings.resize(to_birth, n_genes, n_nodes);
+	offsprings.n_inputs = pool.n_inputs;
+	offsprings.n_outputs = pool.n_outputs;
+	offsprings.mutation_weight_step = pool.mutation_weight_step;
+	parallel_for(n_batches, n_threads, [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; ++b)
+			offsprings.place(batch_pools[b], b * Batch_Size, gene_offsets[b], node_offsets[b]);
+	}, 1);
 }
 
 void Population::speciate() noexcept {
+	constexpr size_t None = SIZE_MAX;
+
+	// The cache points into the genes of the last call.
+	std::swap(genes, previous_genes);
+	genes.build(genomes, n_threads);
+	representative_genes.clear();
+	for (auto& x : specie_representatives) representative_genes.push(x);
+
+	if (cached_treshold != specie_treshold) species_cache.clear();
+	cached_treshold = specie_treshold;
+
+	std::unordered_map<size_t, size_t> representative_index;
+	for (size_t j = 0; j < representative_ids.size(); ++j) representative_index[representative_ids[j]] = j;
+
+	// Copies share their distances, only the first one of each is compared. Without genes the
+	// distance is not a number and a genome never joins anything, not even its copy. Genomes of
+	// the same fingerprint are compared, a collision is left on its own.
+	std::vector<size_t> first_copy(genomes.size());
+	{
+		std::unordered_map<uint64_t, size_t> firsts;
+		firsts.reserve(genomes.size());
+		for (size_t i = 0; i < genomes.size(); ++i) {
+			first_copy[i] = i;
+			if (genomes[i].connection_genes.empty() || specie_treshold <= 0) continue;
+
+			size_t first = firsts.try_emplace(genes.fingerprints[i], i).first->second;
+			if (Gene_Pool::same(genes, i, genes, first)) first_copy[i] = first;
+		}
+	}
 
-	species.clear();
-	species.resize(specie_representatives.size());
+	// Against the representatives of the previous generations, every genome on its own.
+	size_t n_old = specie_representatives.size();
+	std::vector<size_t> assignments(genomes.size(), None);
+	parallel_for(genomes.size(), n_threads, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			if (first_copy[i] != i) continue;
+
+			// A genome seen last time goes back to its specie if its representative is still
+			// there: the representatives before it were all too far then and still are.
+			auto cached = species_cache.find(genes.fingerprints[i]);
+			bool seen =
+				cached != species_cache.end() &&
+				Gene_Pool::same(genes, i, previous_genes, cached->second.genome);
+			if (seen) {
+				auto it = representative_index.find(cached->second.representative_id);
+				if (it != representative_index.end()) {
+					assignments[i] = it->second;
+					continue;
+				}
+			}
 
+			for (size_t j = 0; j < n_old; ++j) {
+				float d = Gene_Pool::distance(genes, i, representative_genes, j, genomes[i]);
+				if (d < specie_treshold) {
+					assignments[i] = j;
+					break;
+				}
+			}
+		}
+	});
+
+	// The rest found new species in order, each one only needs the species founded before it.
 	for (size_t i = 0; i < genomes.size(); ++i) {
-		auto& x = genomes[i];
-		
-		for (size_t j = 0; j < specie_representatives.size(); ++j) {
-			if (Genome::speciation_coeff(x, specie_representatives[j]) < specie_treshold) {
-				species[j].push_back(i);
-				goto continue_outer;
+		if (first_copy[i] != i) assignments[i] = assignments[first_copy[i]];
+		if (assignments[i] != None) continue;
+
+		for (size_t j = n_old; j < specie_representatives.size(); ++j) {
+			float d = Gene_Pool::distance(genes, i, representative_genes, j, genomes[i]);
+			if (d < specie_treshold) {
+				assignments[i] = j;
+				break;
 			}
 		}
+		if (assignments[i] != None) continue;
 
-		specie_representatives.push_back(x);
-		species.push_back({i});
+		assignments[i] = specie_representatives.size();
+		specie_representatives.push_back(genomes[i]);
+		representative_ids.push_back(next_representative_id++);
+		representative_genes.push(genomes[i]);
+	}
 
-continue_outer:
-		continue;
+	species.clear();
+	species.resize(specie_representatives.size());
+	species_cache.clear();
+	for (size_t i = 0; i < genomes.size(); ++i) {
+		species[assignments[i]].push_back(i);
+		species_cache[genes.fingerprints[i]] = { representative_ids[assignments[i]], i };
 	}
 
-	for (size_t i = species.size() - 1; i + 1 > 0 ; i--) {
-		if (species[i].size() == 0) {
-			species[i] = species.back();
-			species.pop_back();
-			specie_representatives[i] = specie_representatives.back();
-			specie_representatives.pop_back();
+	// Empty species are removed in order. The representatives ahead of a cached specie stay the
+	// same ones minus the removed ones, so the scan would still pick it first.
+	size_t kept = 0;
+	for (size_t i = 0; i < species.size(); ++i) {
+		if (species[i].empty()) continue;
+		if (kept != i) {
+			species[kept] = std::move(species[i]);
+			specie_representatives[kept] = std::move(specie_representatives[i]);
+			representative_ids[kept] = representative_ids[i];
 		}
+		kept++;
 	}
-
+	species.erase(species.begin() + kept, species.end());
+	specie_representatives.erase(specie_representatives.begin() + kept, specie_representatives.end());
+	representative_ids.erase(representative_ids.begin() + kept, representative_ids.end());
 }
 
-Population Population::generate(size_t pop_size, size_t n_inputs, size_t n_outputs) noexcept {
+Population Population::generate(
+	size_t pop_size, size_t n_inputs, size_t n_outputs, uint64_t seed
+) noexcept {
 	Population pop;
 	pop.population_size = pop_size;
-	Genome g = Genome::generate(n_inputs, n_outputs);
+	pop.seed = seed;
+
+	auto rng = pcg32_seed(seed, 0);
+	Genome g = Genome::generate(n_inputs, n_outputs, rng);
 	for (size_t i = 0; i < pop_size; ++i) pop.genomes.push_back(g);
 	return pop;
 }
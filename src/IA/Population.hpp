@@ -1,6 +1,10 @@
 #pragma once
 
+#include <unordered_map>
+
+#include "Gene_Pool.hpp"
 #include "Genome.hpp"
+#include "Random/Alias_Table.hpp"
 
 struct Population {
 	size_t population_size;
@@ -8,10 +12,48 @@ struct Population {
 	std::vector<Genome> genomes;
 	std::vector<std::vector<size_t>> species;
 	std::vector<Genome> specie_representatives;
+	// Stable across generations, unlike the index of a specie.
+	std::vector<size_t> representative_ids;
+	size_t next_representative_id = 0;
+
+	// Representative id a genome went to, by fingerprint. Representatives never change so a
+	// genome seen again goes back to its specie without any distance.
+	struct Cached_Specie {
+		size_t representative_id;
+		// Into previous_genes, a fingerprint alone could collide.
+		size_t genome;
+	};
+	std::unordered_map<uint64_t, Cached_Specie> species_cache;
+	float cached_treshold = 0;
+	Gene_Pool genes;
+	Gene_Pool previous_genes;
+	Gene_Pool representative_genes;
+
+	// 0 uses every hardware thread.
+	size_t n_threads = 0;
+	// With the number of reproductions so far, seeds the streams of a reproduction.
+	uint64_t seed = 0;
+	uint64_t n_reproductions = 0;
+
+	// Genomes killed by selection, their buffers are reused by the next offsprings.
+	std::vector<Genome> recycled;
+
+	// Scratch of selection.
+	std::vector<Genome> selected;
+	std::vector<size_t> specie_of;
+	std::vector<uint8_t> keep;
+	std::vector<size_t> order;
+	// Scratch of reproduction.
+	std::vector<float> fitnesses;
+	Alias_Table parents;
+	// Offsprings of breed, one pool per batch.
+	std::vector<Gene_Pool> batch_pools;
 
 	float specie_treshold = 3.f;
 
 	float mutation_add_node = 0.005f;
+	// Off by default, the experiments have no memory to learn.
+	float mutation_add_lstm = 0.f;
 	float mutation_del_node = 0.0001f;
 	float mutation_add_connection = 0.05f;
 	float mutation_del_connection = 0.001f;
@@ -26,9 +68,15 @@ struct Population {
 
 	void selection() noexcept;
 	void reproduction() noexcept;
+	// reproduction over flat gene pools, genomes is left alone. pool holds the parents with their
+	// adjusted fitness in order, offsprings gets the population_size - pool.size() genomes
+	// reproduction would have appended, ages aside.
+	void breed(const Gene_Pool& pool, const float* adjusted_fitnesses, Gene_Pool& offsprings) noexcept;
 	void speciate() noexcept;
 
-	static Population generate(size_t pop_size, size_t n_inputs, size_t n_outputs) noexcept;
+	static Population generate(
+		size_t pop_size, size_t n_inputs, size_t n_outputs, uint64_t seed = 0
+	) noexcept;
 
 private:
 };
\ No newline at end of file
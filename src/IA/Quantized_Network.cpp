@@ -0,0 +1,224 @@
+#include "Quantized_Network.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+#include "macros.hpp"
+#include "Fast_Math.hpp"
+
+namespace {
+	// x is already in units of the values. Saturates, clamping on the integer keeps the loops
+	// calling it vectorizable.
+	int16_t quantize_value(float x) noexcept {
+		constexpr int32_t Max = Quantized_Network::Value_Max;
+		int32_t q = (int32_t)fast_math::round_nearest(x);
+		return (int16_t)std::min(std::max(q, -Max), Max);
+	}
+}
+
+Quantized_Network Quantized_Network::quantize(
+	const Network& net, const float* samples, size_t n_samples
+) noexcept {
+	Quantized_Network q;
+	q.n_inputs = net.n_inputs;
+	q.n_outputs = net.n_outputs;
+	q.n_slots = net.n_slots;
+	q.funcs = net.plan.funcs;
+	q.groups = net.plan.groups;
+	q.output_slots = net.plan.output_slots;
+	q.cells = net.plan.cells;
+
+	// Calibration, the largest value any slot reaches on the samples.
+	float max_value = 0;
+	{
+		size_t tile = std::max((size_t)1, std::min(Network::Batch_Tile, n_samples));
+		std::vector<float> columns(net.n_slots * tile);
+		auto v = net.view();
+
+		for (size_t beg = 0; beg < n_samples; beg += tile) {
+			size_t rows = std::min(tile, n_samples - beg);
+			for (size_t i = 0; i < net.n_inputs; ++i)
+				for (size_t r = 0; r < rows; ++r)
+					columns[i * tile + r] = samples[(beg + r) * net.n_inputs + i];
+
+			Network::run_groups(v, {}, columns.data(), tile, rows, net.fast_activations);
+
+			for (size_t s = 0; s < net.n_slots; ++s)
+				for (size_t r = 0; r < rows; ++r)
+					max_value = std::max(max_value, std::abs(columns[s * tile + r]));
+		}
+	}
+	q.scale = max_value > 0 ? max_value / Value_Max : 1.f;
+
+	// One weight scale per node, delayed links left out.
+	q.offsets.push_back(0);
+	for (size_t k = 0; k < net.plan.order.size(); ++k) {
+		float max_weight = 0;
+		for (size_t l = net.plan.offsets[k]; l < net.plan.offsets[k + 1]; ++l)
+			if (net.plan.sources[l] < net.n_slots)
+				max_weight = std::max(max_weight, std::abs(net.plan.weights[l]));
+
+		float weight_scale = max_weight > 0 ? max_weight / Weight_Max : 1.f;
+		for (size_t l = net.plan.offsets[k]; l < net.plan.offsets[k + 1]; ++l) {
+			if (net.plan.sources[l] >= net.n_slots) continue;
+			q.sources.push_back(net.plan.sources[l]);
+			q.weights.push_back((int8_t)std::round(net.plan.weights[l] / weight_scale));
+		}
+		q.offsets.push_back((uint32_t)q.sources.size());
+		q.sum_scales.push_back(q.scale * weight_scale);
+	}
+
+	return q;
+}
+
+void Quantized_Network::compute(const float* inputs, size_t n_rows, float* outputs) noexcept {
+	size_t tile = std::min(Network::Batch_Tile, n_rows);
+	columns.resize(n_slots * tile);
+	sums.resize(n_slots * tile);
+
+	float inv_scale = 1 / scale;
+
+	for (size_t beg = 0; beg < n_rows; beg += tile) {
+		size_t rows = std::min(tile, n_rows - beg);
+		size_t cell = 0;
+
+		for (size_t i = 0; i < n_inputs; ++i) {
+			int16_t* column = columns.data() + i * tile;
+			for (size_t r = 0; r < rows; ++r)
+				column[r] = quantize_value(inputs[(beg + r) * n_inputs + i] * inv_scale);
+		}
+
+		for (auto& group : groups) {
+			using Activation = Network::Node::Activation;
+			auto func = group.func;
+
+			// The piecewise linear activations go straight from the integer sum to the next value.
+			bool integer =
+				func == Activation::Linear ||
+				func == Activation::Add ||
+				func == Activation::Relu ||
+				func == Activation::Sign;
+
+			for (size_t slot = group.begin; slot < group.end; ++slot) {
+				size_t k = slot - n_inputs;
+				float* __restrict sum = sums.data() + slot * tile;
+				float sum_scale = sum_scales[k];
+
+				// Mult nodes are rare, their product stays in float.
+				if (func == Activation::Mult) {
+					float init = offsets[k] < offsets[k + 1] ? 1.f : 0.f;
+					for (size_t r = 0; r < rows; ++r) sum[r] = init;
+					for (size_t l = offsets[k]; l < offsets[k + 1]; ++l) {
+						const int16_t* x = columns.data() + sources[l] * tile;
+						float w = weights[l] * sum_scale;
+						for (size_t r = 0; r < rows; ++r) sum[r] *= x[r] * w;
+					}
+					continue;
+				}
+
+				// Accumulated on 32 bits, a link adds at most 2^22.
+				int32_t acc[Network::Batch_Tile];
+				for (size_t r = 0; r < rows; ++r) acc[r] = 0;
+				// Links two at a time, halves the passes over acc and lets pairs of 16 bit
+				// products be summed in one step (pmaddwd).
+				size_t l = offsets[k];
+				for (; l + 1 < offsets[k + 1]; l += 2) {
+					const int16_t* __restrict x0 = columns.data() + sources[l] * tile;
+					const int16_t* __restrict x1 = columns.data() + sources[l + 1] * tile;
+					int16_t w0 = weights[l];
+					int16_t w1 = weights[l + 1];
+					for (size_t r = 0; r < rows; ++r) acc[r] += x0[r] * w0 + x1[r] * w1;
+				}
+				if (l < offsets[k + 1]) {
+					const int16_t* __restrict x = columns.data() + sources[l] * tile;
+					int16_t w = weights[l];
+					for (size_t r = 0; r < rows; ++r) acc[r] += x[r] * w;
+				}
+
+				if (!integer) {
+					for (size_t r = 0; r < rows; ++r) sum[r] = acc[r] * sum_scale;
+					continue;
+				}
+
+				// In units of the values, sum_scale / scale is the weight scale.
+				int16_t* __restrict out = columns.data() + slot * tile;
+				float to_value = sum_scale * inv_scale;
+				if (func == Activation::Sign) {
+					int16_t one = quantize_value(inv_scale);
+					for (size_t r = 0; r < rows; ++r) out[r] = acc[r] > 0 ? one : 0;
+				}
+				else if (func == Activation::Relu) {
+					// max(acc, 0) without a branch.
+					for (size_t r = 0; r < rows; ++r) out[r] = quantize_value((acc[r] & ~(acc[r] >> 31)) * to_value);
+				}
+				else {
+					for (size_t r = 0; r < rows; ++r) out[r] = quantize_value(acc[r] * to_value);
+				}
+			}
+			if (integer) continue;
+
+			// Same as Network::run_groups, the padding rows of a partial tile are left out.
+			float* block = sums.data() + group.begin * tile;
+			size_t n = group.end - group.begin;
+			if (func == Activation::LSTM) {
+				Network::run_cells(cells.data() + cell, n, 0, {}, block, tile, rows, fast_activations);
+				cell += n;
+			}
+			else if (rows == tile) Network::Node::apply(block, n * tile, func, fast_activations);
+			else for (size_t j = 0; j < n; ++j) Network::Node::apply(block + j * tile, rows, func, fast_activations);
+
+			int16_t* out = columns.data() + group.begin * tile;
+			for (size_t j = 0; j < n; ++j)
+				for (size_t r = 0; r < rows; ++r) out[j * tile + r] = quantize_value(block[j * tile + r] * inv_scale);
+		}
+
+		for (size_t o = 0; o < n_outputs; ++o) {
+			const int16_t* column = columns.data() + output_slots[o] * tile;
+			for (size_t r = 0; r < rows; ++r) outputs[(beg + r) * n_outputs + o] = column[r] * scale;
+		}
+	}
+}
+
+Quantized_Network::Report Quantized_Network::compare(
+	Network& net, const float* inputs, size_t n_rows
+) noexcept {
+	std::vector<float> expected(n_rows * n_outputs);
+	std::vector<float> got(n_rows * n_outputs);
+	net.compute(inputs, n_rows, expected.data());
+	compute(inputs, n_rows, got.data());
+
+	Report report;
+	report.n_rows = n_rows;
+	if (!n_rows || !n_outputs) return report;
+
+	double error_sum = 0;
+	size_t agree = 0;
+	for (size_t r = 0; r < n_rows; ++r) {
+		auto e = expected.data() + r * n_outputs;
+		auto g = got.data() + r * n_outputs;
+
+		for (size_t o = 0; o < n_outputs; ++o) {
+			float error = std::abs(e[o] - g[o]);
+			report.max_error = std::max(report.max_error, error);
+			error_sum += error;
+		}
+
+		if (n_outputs == 1) agree += (e[0] > .5f) == (g[0] > .5f);
+		else agree += std::max_element(e, e + n_outputs) - e == std::max_element(g, g + n_outputs) - g;
+	}
+
+	report.mean_error = (float)(error_sum / (n_rows * n_outputs));
+	report.agreement = 1.f * agree / n_rows;
+	return report;
+}
+
+void Quantized_Network::Report::print() const noexcept {
+	printf(
+		"%zu rows, max error %g, mean error %g, %.2f%% same decisions\n",
+		n_rows,
+		max_error,
+		mean_error,
+		100 * agreement
+	);
+}
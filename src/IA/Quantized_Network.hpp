@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Network.hpp"
+
+// Fixed point copy of a Network plan: int16 values sharing one scale for the whole network and
+// int8 weights with one scale per node. The links run on integers, the activations still run on
+// the float kernels between a dequantization and a requantization of the node's column.
+// Evaluation is stateless, links closing a cycle are left out and LSTM cells start from 0 on every
+// row, their gates run in float.
+// Opt-in, nothing evaluates through it unless asked to. It is slower than the float plan on the
+// narrow graphs evolved so far, bench_quantized reports its error and speed.
+struct Quantized_Network {
+	static constexpr int32_t Value_Max = 32767;
+	static constexpr int32_t Weight_Max = 127;
+
+	size_t n_inputs = 0;
+	size_t n_outputs = 0;
+	size_t n_slots = 0;
+
+	std::vector<Network::Node::Activation> funcs;
+	std::vector<Network::Group> groups;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> sources;
+	std::vector<int8_t> weights;
+	// Per node, turns its integer sum back into a float pre-activation.
+	std::vector<float> sum_scales;
+	std::vector<uint32_t> output_slots;
+	std::vector<Network::Cell> cells;
+
+	// Real value of one unit of the int16 values.
+	float scale = 1;
+	bool fast_activations = true;
+
+	// Scratch, one column of at most Network::Batch_Tile rows per slot.
+	std::vector<int16_t> columns;
+	std::vector<float> sums;
+
+	struct Report {
+		size_t n_rows = 0;
+		float max_error = 0;
+		float mean_error = 0;
+		// Rows where both paths pick the same output, or the same side of 0.5 with a single one.
+		float agreement = 0;
+
+		void print() const noexcept;
+	};
+
+	// samples is n_samples x n_inputs row major, the values reached on them set the scale.
+	static Quantized_Network quantize(const Network& net, const float* samples, size_t n_samples) noexcept;
+
+	// Same layout as Network::compute.
+	void compute(const float* inputs, size_t n_rows, float* outputs) noexcept;
+
+	// Runs both paths on inputs and compares their outputs.
+	Report compare(Network& net, const float* inputs, size_t n_rows) noexcept;
+};
@@ -0,0 +1,58 @@
+#include "OS/library.hpp"
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Error {
+	constexpr auto Dl_Open = 1;
+	constexpr auto No_Home = 2;
+	constexpr auto Not_Private = 3;
+}
+
+const char* library::extension() noexcept {
+	return ".so";
+}
+
+xstd::std_expected<library::Library>
+library::load_library(const std::filesystem::path& path) noexcept {
+	auto handle = dlopen(path.string().c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (!handle) return Error::Dl_Open;
+
+	Library library;
+	library.handle = handle;
+	return library;
+}
+
+void* library::find_symbol(const Library& library, const char* name) noexcept {
+	if (!library.handle) return nullptr;
+	return dlsym(library.handle, name);
+}
+
+void library::unload_library(Library& library) noexcept {
+	if (library.handle) dlclose(library.handle);
+	library = {};
+}
+
+bool library::make_private_directory(const std::filesystem::path& path) noexcept {
+	std::error_code ec;
+	if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+	if (mkdir(path.c_str(), 0700) != 0 && errno != EEXIST) return false;
+
+	// lstat, a link could point anywhere.
+	struct stat st;
+	if (lstat(path.c_str(), &st) != 0) return false;
+	return S_ISDIR(st.st_mode) && st.st_uid == geteuid() && (st.st_mode & 077) == 0;
+}
+
+xstd::std_expected<std::filesystem::path> library::cache_directory(const char* name) noexcept {
+	std::filesystem::path base;
+	if (auto xdg = getenv("XDG_CACHE_HOME"); xdg && xdg[0] == '/') base = xdg;
+	else if (auto home = getenv("HOME"); home && home[0] == '/') base = std::filesystem::path(home) / ".cache";
+	else return Error::No_Home;
+
+	auto path = base / name;
+	if (!make_private_directory(path)) return Error::Not_Private;
+	return path;
+}
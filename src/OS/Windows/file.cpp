@@ -18,6 +18,8 @@ namespace Error {
 	X(Win_File_Write);
 	X(Win_File_Incomplete_Write);
 	X(Unsupported_Operation);
+	X(Win_File_Mapping);
+	X(Win_Map_View);
 #undef X
 }
 
@@ -119,6 +121,57 @@ bool file::overwrite_file(const std::filesystem::path& path, std::string_view st
 
 	return true;
 }
+
+xstd::std_expected<file::Mapped_File>
+file::map_file(const std::filesystem::path& path) noexcept {
+	auto handle = CreateFile(
+		path.string().c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr
+	);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return Error::Win_Create_File;
+	}
+
+	LARGE_INTEGER large_int;
+	GetFileSizeEx(handle, &large_int);
+	if (large_int.QuadPart == 0) {
+		CloseHandle(handle);
+		return Error::Win_File_Size;
+	}
+
+	auto mapping = CreateFileMapping(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		CloseHandle(handle);
+		return Error::Win_File_Mapping;
+	}
+
+	auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(mapping);
+		CloseHandle(handle);
+		return Error::Win_Map_View;
+	}
+
+	Mapped_File file;
+	file.data = (const std::uint8_t*)view;
+	file.size = (size_t)large_int.QuadPart;
+	file.file_handle = handle;
+	file.mapping_handle = mapping;
+	return file;
+}
+
+void file::unmap_file(Mapped_File& file) noexcept {
+	if (file.data) UnmapViewOfFile(file.data);
+	if (file.mapping_handle) CloseHandle(file.mapping_handle);
+	if (file.file_handle) CloseHandle(file.file_handle);
+	file = {};
+}
+
 const char* create_cstr_extension_label_map(
 decltype(file::OpenFileOpts::ext_filters) filters
 ) noexcept {
@@ -0,0 +1,49 @@
+#include "OS/library.hpp"
+#include <stdlib.h>
+#include <Windows.h>
+
+namespace Error {
+	constexpr auto Win_Load_Library = 1;
+	constexpr auto No_Local_App_Data = 2;
+	constexpr auto Not_Private = 3;
+}
+
+const char* library::extension() noexcept {
+	return ".dll";
+}
+
+xstd::std_expected<library::Library>
+library::load_library(const std::filesystem::path& path) noexcept {
+	auto module = LoadLibraryA(path.string().c_str());
+	if (!module) return Error::Win_Load_Library;
+
+	Library library;
+	library.handle = module;
+	return library;
+}
+
+void* library::find_symbol(const Library& library, const char* name) noexcept {
+	if (!library.handle) return nullptr;
+	return (void*)GetProcAddress((HMODULE)library.handle, name);
+}
+
+void library::unload_library(Library& library) noexcept {
+	if (library.handle) FreeLibrary((HMODULE)library.handle);
+	library = {};
+}
+
+bool library::make_private_directory(const std::filesystem::path& path) noexcept {
+	std::error_code ec;
+	std::filesystem::create_directories(path, ec);
+	return std::filesystem::is_directory(path, ec) && !std::filesystem::is_symlink(path, ec);
+}
+
+xstd::std_expected<std::filesystem::path> library::cache_directory(const char* name) noexcept {
+	// Only readable by its user, a new directory inherits its rights.
+	auto local = getenv("LOCALAPPDATA");
+	if (!local || !local[0]) return Error::No_Local_App_Data;
+
+	auto path = std::filesystem::path(local) / name;
+	if (!make_private_directory(path)) return Error::Not_Private;
+	return path;
+}
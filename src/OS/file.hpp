@@ -20,6 +20,19 @@ namespace file {
 
 	extern bool
 		overwrite_file(const std::filesystem::path& path, std::string_view str) noexcept;
+
+	// Read only view of a whole file, stays valid until unmap_file.
+	struct Mapped_File {
+		const std::uint8_t* data{ nullptr };
+		size_t size{ 0 };
+
+		void* file_handle{ nullptr };
+		void* mapping_handle{ nullptr };
+	};
+	[[nodiscard]] extern xstd::std_expected<Mapped_File>
+		map_file(const std::filesystem::path& path) noexcept;
+	extern void unmap_file(Mapped_File& file) noexcept;
+
 	struct OpenFileOpts {
 		void* owner{ nullptr };
 
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include "xstd.hpp"
+
+namespace library {
+	// Shared library loaded at runtime, stays loaded until unload_library.
+	struct Library {
+		void* handle{ nullptr };
+	};
+
+	// ".dll" or ".so".
+	extern const char* extension() noexcept;
+
+	[[nodiscard]] extern xstd::std_expected<Library>
+		load_library(const std::filesystem::path& path) noexcept;
+	// nullptr if the library does not export it.
+	extern void* find_symbol(const Library& library, const char* name) noexcept;
+	extern void unload_library(Library& library) noexcept;
+
+	// Creates path if missing. Fails unless it is a directory of the current user that nobody
+	// else can write to, on Windows the rights are left to the parent directory.
+	[[nodiscard]] extern bool make_private_directory(const std::filesystem::path& path) noexcept;
+	// name in the cache directory of the current user ($XDG_CACHE_HOME, ~/.cache or
+	// %LOCALAPPDATA%), made private.
+	[[nodiscard]] extern xstd::std_expected<std::filesystem::path>
+		cache_directory(const char* name) noexcept;
+}
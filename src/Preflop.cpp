@@ -0,0 +1,185 @@
+#include "Preflop.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "Equity.hpp"
+
+namespace {
+	// Every concrete hole cards of a hand index.
+	size_t concrete_holes(size_t hand, std::array<std::array<Card, 2>, 12>& out) noexcept {
+		size_t row = hand / (size_t)Value::Size;
+		size_t col = hand % (size_t)Value::Size;
+		size_t n = 0;
+
+		for (size_t a = 0; a < (size_t)Color::Size; ++a) {
+			for (size_t b = 0; b < (size_t)Color::Size; ++b) {
+				bool suited = a == b;
+				if (row > col && !suited) continue;
+				if (row < col && suited) continue;
+				if (row == col && a >= b) continue;
+
+				out[n++] = { Card{ (Color)a, (Value)row }, Card{ (Color)b, (Value)col } };
+			}
+		}
+
+		return n;
+	}
+}
+
+Preflop_Table::~Preflop_Table() noexcept {
+	unload();
+}
+
+bool Preflop_Table::load(const std::filesystem::path& path) noexcept {
+	unload();
+
+	auto mapped = file::map_file(path);
+	if (!mapped) return false;
+	file = *mapped;
+
+	if (file.size < sizeof(Header)) {
+		unload();
+		return false;
+	}
+
+	auto h = (const Header*)file.data;
+	size_t expected_size =
+		sizeof(Header) + sizeof(float) * N_Hands * (N_Hands + (size_t)h->max_opponents);
+
+	bool valid =
+		h->magic == Magic &&
+		h->version == Version &&
+		h->n_hands == N_Hands &&
+		h->max_opponents > 0 &&
+		file.size == expected_size;
+	if (!valid) {
+		unload();
+		return false;
+	}
+
+	header = h;
+	matchups = (const float*)(file.data + sizeof(Header));
+	randoms = matchups + N_Hands * N_Hands;
+	return true;
+}
+
+void Preflop_Table::unload() noexcept {
+	file::unmap_file(file);
+	header = nullptr;
+	matchups = nullptr;
+	randoms = nullptr;
+}
+
+bool Preflop_Table::generate(
+	const std::filesystem::path& path,
+	size_t samples,
+	size_t max_opponents,
+	uint64_t seed,
+	size_t n_threads
+) noexcept {
+	max_opponents = std::clamp(max_opponents, (size_t)1, Equity::Max_Opponents);
+
+	std::vector<float> matchups(N_Hands * N_Hands, 0.5f);
+	std::vector<float> randoms(N_Hands * max_opponents, 0.f);
+
+	// One work item per (hand, other) with hand < other, then one per (hand, n_opponents).
+	size_t n_matchups = N_Hands * (N_Hands - 1) / 2;
+	size_t n_items = n_matchups + N_Hands * max_opponents;
+
+	std::vector<std::pair<uint8_t, uint8_t>> matchup_items;
+	matchup_items.reserve(n_matchups);
+	for (size_t i = 0; i < N_Hands; ++i)
+		for (size_t j = i + 1; j < N_Hands; ++j) matchup_items.push_back({ (uint8_t)i, (uint8_t)j });
+
+	std::atomic<size_t> next_item = 0;
+	auto work = [&] {
+		std::array<std::array<Card, 2>, 12> holes;
+		std::array<std::array<Card, 2>, 12> others;
+
+		Equity equity;
+		equity.mode = Equity::Mode::Monte_Carlo;
+		equity.n_threads = 1;
+
+		for (size_t item; (item = next_item.fetch_add(1)) < n_items;) {
+			// Each item is seeded on its own stream so the file only depends on the seed.
+			equity.seed = seed + item * 0x9E3779B97F4A7C15ull;
+
+			if (item < n_matchups) {
+				auto [i, j] = matchup_items[item];
+				size_t n_holes = concrete_holes(i, holes);
+				size_t n_others = concrete_holes(j, others);
+
+				size_t n_pairs = 0;
+				for (size_t a = 0; a < n_holes; ++a) for (size_t b = 0; b < n_others; ++b)
+					n_pairs += (CardSet::from(holes[a]) & CardSet::from(others[b])).empty();
+
+				equity.n_opponents = 1;
+				equity.n_known_opponents = 1;
+				equity.n_samples = std::max((size_t)1, samples / n_pairs);
+
+				double share = 0;
+				for (size_t a = 0; a < n_holes; ++a) for (size_t b = 0; b < n_others; ++b) {
+					if (!(CardSet::from(holes[a]) & CardSet::from(others[b])).empty()) continue;
+
+					equity.hole = holes[a];
+					equity.known_opponents[0] = others[b];
+					share += equity.monte_carlo().share;
+					equity.seed++;
+				}
+				share /= n_pairs;
+
+				matchups[i * N_Hands + j] = (float)share;
+				matchups[j * N_Hands + i] = (float)(1 - share);
+			}
+			else {
+				size_t hand = (item - n_matchups) / max_opponents;
+				size_t n_opponents = 1 + (item - n_matchups) % max_opponents;
+				size_t n_holes = concrete_holes(hand, holes);
+
+				equity.n_opponents = n_opponents;
+				equity.n_known_opponents = 0;
+				equity.n_samples = std::max((size_t)1, samples / n_holes);
+
+				double share = 0;
+				for (size_t a = 0; a < n_holes; ++a) {
+					equity.hole = holes[a];
+					share += equity.monte_carlo().share;
+					equity.seed++;
+				}
+
+				randoms[hand * max_opponents + n_opponents - 1] = (float)(share / n_holes);
+			}
+		}
+	};
+
+	size_t threads = n_threads ? n_threads : std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (size_t i = 1; i < threads; ++i) workers.emplace_back(work);
+	work();
+	for (auto& x : workers) x.join();
+
+	Header header;
+	header.magic = Magic;
+	header.version = Version;
+	header.n_hands = N_Hands;
+	header.max_opponents = (uint32_t)max_opponents;
+	header.samples = samples;
+	header.seed = seed;
+
+	std::vector<std::uint8_t> bytes(
+		sizeof(Header) + sizeof(float) * (matchups.size() + randoms.size())
+	);
+	auto it = bytes.data();
+	memcpy(it, &header, sizeof(Header));
+	it += sizeof(Header);
+	memcpy(it, matchups.data(), sizeof(float) * matchups.size());
+	it += sizeof(float) * matchups.size();
+	memcpy(it, randoms.data(), sizeof(float) * randoms.size());
+
+	return file::overwrite_file_byte(path, bytes) == 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <stdint.h>
+
+#include "poker.hpp"
+#include "OS/file.hpp"
+
+// Preflop equities of the 169 distinct starting hands, generated offline and memory mapped.
+// A hand index is high * 13 + low when suited, low * 13 + high otherwise (pairs included).
+//
+// File layout, native endianness:
+//   Header
+//   float[N_Hands][N_Hands]        share of the pot of the row hand against the column hand
+//   float[N_Hands][max_opponents]  share of the pot against 1..max_opponents random hands
+struct Preflop_Table {
+	static constexpr size_t N_Hands = (size_t)Value::Size * (size_t)Value::Size;
+	static constexpr uint32_t Magic = 0x46504B50; // "PKPF"
+	static constexpr uint32_t Version = 1;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t n_hands;
+		uint32_t max_opponents;
+		uint64_t samples;
+		uint64_t seed;
+	};
+
+	Preflop_Table() noexcept = default;
+	Preflop_Table(const Preflop_Table&) = delete;
+	Preflop_Table& operator=(const Preflop_Table&) = delete;
+	~Preflop_Table() noexcept;
+
+	static size_t index(Card a, Card b) noexcept {
+		size_t high = std::max((size_t)a.value, (size_t)b.value);
+		size_t low = std::min((size_t)a.value, (size_t)b.value);
+		if (a.color == b.color) return high * (size_t)Value::Size + low;
+		return low * (size_t)Value::Size + high;
+	}
+	static size_t index(const std::array<Card, 2>& hole) noexcept { return index(hole[0], hole[1]); }
+
+	bool loaded() const noexcept { return header != nullptr; }
+	size_t max_opponents() const noexcept { return header->max_opponents; }
+
+	float versus(size_t hand, size_t other) const noexcept {
+		return matchups[hand * N_Hands + other];
+	}
+	float versus_random(size_t hand, size_t n_opponents) const noexcept {
+		n_opponents = std::min(n_opponents, (size_t)header->max_opponents);
+		return randoms[hand * header->max_opponents + n_opponents - 1];
+	}
+	float strength(const std::array<Card, 2>& hole, size_t n_opponents) const noexcept {
+		return versus_random(index(hole), n_opponents);
+	}
+
+	// Maps the file, nothing is parsed besides the header checks.
+	bool load(const std::filesystem::path& path) noexcept;
+	void unload() noexcept;
+
+	// Monte Carlo over every concrete suit combination of each matchup, `samples` per matchup.
+	static bool generate(
+		const std::filesystem::path& path,
+		size_t samples,
+		size_t max_opponents,
+		uint64_t seed = 0,
+		size_t n_threads = 0
+	) noexcept;
+
+private:
+	file::Mapped_File file;
+
+	const Header* header{ nullptr };
+	const float* matchups{ nullptr };
+	const float* randoms{ nullptr };
+};
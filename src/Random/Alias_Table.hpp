@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Random.hpp"
+
+// Vose's alias method, draws index i with probability weights[i] / sum(weights) in O(1) after an
+// O(n) build. Without any positive weight every index is equally likely.
+struct Alias_Table {
+	std::vector<float> probabilities;
+	std::vector<uint32_t> aliases;
+
+	// Scratch of build.
+	std::vector<uint32_t> small;
+	std::vector<uint32_t> large;
+	std::vector<float> scaled;
+
+	size_t size() const noexcept { return aliases.size(); }
+
+	void build(const float* weights, size_t n) noexcept {
+		probabilities.assign(n, 1.f);
+		aliases.resize(n);
+		for (size_t i = 0; i < n; ++i) aliases[i] = (uint32_t)i;
+
+		double sum = 0;
+		for (size_t i = 0; i < n; ++i) sum += weights[i] > 0 ? weights[i] : 0;
+		if (sum <= 0) return;
+
+		scaled.resize(n);
+		small.clear();
+		large.clear();
+		for (size_t i = 0; i < n; ++i) {
+			scaled[i] = (float)((weights[i] > 0 ? weights[i] : 0) * n / sum);
+			(scaled[i] < 1 ? small : large).push_back((uint32_t)i);
+		}
+
+		while (!small.empty() && !large.empty()) {
+			uint32_t s = small.back();
+			uint32_t l = large.back();
+			small.pop_back();
+
+			probabilities[s] = scaled[s];
+			aliases[s] = l;
+
+			scaled[l] = (scaled[l] + scaled[s]) - 1;
+			if (scaled[l] < 1) {
+				large.pop_back();
+				small.push_back(l);
+			}
+		}
+		// What is left is 1 up to rounding.
+		for (auto i : small) probabilities[i] = 1;
+		for (auto i : large) probabilities[i] = 1;
+	}
+
+	size_t sample(pcg32_random_t& rng) const noexcept {
+		size_t i = random(rng, (uint32_t)aliases.size());
+		return randomf(rng) < probabilities[i] ? i : aliases[i];
+	}
+};
@@ -30,6 +30,15 @@ static inline uint32_t random() {
 END minimalist PCG code
 */
 
+// Same as pcg32_srandom_r, every stream gives an independent sequence.
+static inline pcg32_random_t pcg32_seed(uint64_t seed, uint64_t stream) {
+    pcg32_random_t rng = { 0u, (stream << 1u) | 1u };
+    pcg32_random_r(&rng);
+    rng.state += seed;
+    pcg32_random_r(&rng);
+    return rng;
+}
+
 // map random value to [0,range) with slight bias
 static inline uint32_t random(uint32_t range) {
     uint64_t random32bit, multiresult;
@@ -38,6 +47,13 @@ static inline uint32_t random(uint32_t range) {
     return multiresult >> 32; // [0, range)
 }
 // map random value to [0,range) with slight bias
+static inline uint32_t random(pcg32_random_t& rng, uint32_t range) {
+    uint64_t random32bit, multiresult;
+    random32bit = pcg32_random_r(&rng);
+    multiresult = random32bit * range;
+    return multiresult >> 32; // [0, range)
+}
+// map random value to [0,range) with slight bias
 static inline double randomf() {
     return random() / (double)(0xffff'ffff);
 }
@@ -46,6 +62,17 @@ static inline double randomnorm(double u, double s) noexcept {
     return std::sqrt(-2 * std::log(randomf())) * std::cos(2 * 3.14159265359 * randomf());
 }
 
+// [0, 1]
+static inline double randomf(pcg32_random_t& rng) {
+    return pcg32_random_r(&rng) / (double)(0xffff'ffff);
+}
+
+// Box-Muller, the uniform is kept in (0, 1] for the log.
+static inline double randomnorm(pcg32_random_t& rng, double u, double s) noexcept {
+    double x = (pcg32_random_r(&rng) + 1.0) / 4294967296.0;
+    return u + s * std::sqrt(-2 * std::log(x)) * std::cos(2 * 3.14159265359 * randomf(rng));
+}
+
 template<typename T>
 void shuffle(T* ptr, size_t size) noexcept {
 	size_t i;
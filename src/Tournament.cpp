@@ -0,0 +1,91 @@
+#include "Tournament.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+#include "Profiler/Timer.hpp"
+
+float Tournament::Result::win_rate(size_t seat) const noexcept {
+	return games ? 1.f * wins[seat] / games : 0.f;
+}
+
+double Tournament::Result::average_chip_delta(size_t seat) const noexcept {
+	return games ? 1.0 * chip_deltas[seat] / games : 0.0;
+}
+
+double Tournament::Result::hands_per_second() const noexcept {
+	return seconds > 0 ? hands / seconds : 0.0;
+}
+
+void Tournament::Result::merge(const Result& other) noexcept {
+	for (size_t i = 0; i < N_Seats; ++i) {
+		wins[i] += other.wins[i];
+		chip_deltas[i] += other.chip_deltas[i];
+	}
+	games += other.games;
+	hands += other.hands;
+}
+
+void Tournament::Result::print() const noexcept {
+	printf("%zu games, %zu hands in %fs (%.0f hands/s)\n", games, hands, seconds, hands_per_second());
+	for (size_t i = 0; i < N_Seats; ++i) {
+		printf(
+			"[%zu] win rate %.3f, average chip delta %+.2f\n",
+			i,
+			win_rate(i),
+			average_chip_delta(i)
+		);
+	}
+}
+
+Tournament::Result Tournament::run() noexcept {
+	size_t threads = n_threads ? n_threads : std::max(1u, std::thread::hardware_concurrency());
+
+	// Each worker only writes its own line.
+	struct alignas(64) Worker_Result {
+		Result result;
+	};
+	std::vector<Worker_Result> results(threads);
+	std::atomic<size_t> next_game = 0;
+
+	auto work = [&](size_t worker) {
+		Game game;
+		auto& result = results[worker].result;
+
+		while (true) {
+			size_t begin = next_game.fetch_add(batch_size, std::memory_order_relaxed);
+			if (begin >= n_games) break;
+			size_t end = std::min(begin + batch_size, n_games);
+
+			for (size_t i = begin; i < end; ++i) {
+				game.reset();
+				game.seed(seed, i);
+				game.play_game();
+
+				for (size_t j = 0; j < N_Seats; ++j) {
+					auto& p = game.players[j];
+					if (p.stack > 0) result.wins[j]++;
+					result.chip_deltas[j] += (int64_t)p.stack - (int64_t)game.starting_stack;
+				}
+				result.games++;
+				result.hands += game.history.total;
+			}
+		}
+	};
+
+	auto t1 = seconds();
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for (size_t i = 1; i < threads; ++i) workers.emplace_back(work, i);
+	work(0);
+	for (auto& x : workers) x.join();
+
+	Result total;
+	for (auto& x : results) total.merge(x.result);
+	total.seconds = seconds() - t1;
+	return total;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <stdint.h>
+
+#include "poker.hpp"
+
+// Plays many independent games of self play over a pool of threads.
+// Every game gets its own PCG stream derived from the seed and its index, so the results only
+// depend on the seed and not on the number of threads.
+struct Tournament {
+	static constexpr size_t N_Seats = 3;
+
+	struct Result {
+		std::array<size_t, N_Seats> wins{};
+		// Sum over every game of the final stack minus the starting stack.
+		std::array<int64_t, N_Seats> chip_deltas{};
+
+		size_t games{ 0 };
+		size_t hands{ 0 };
+		double seconds{ 0 };
+
+		float win_rate(size_t seat) const noexcept;
+		double average_chip_delta(size_t seat) const noexcept;
+		double hands_per_second() const noexcept;
+
+		void merge(const Result& other) noexcept;
+		void print() const noexcept;
+	};
+
+	size_t n_games{ 1000 };
+	// 0 means one per hardware thread.
+	size_t n_threads{ 0 };
+	// Games are handed to the workers by batches to keep the shared counter cold.
+	size_t batch_size{ 64 };
+	uint64_t seed{ 0 };
+
+	Result run() noexcept;
+};
@@ -1,6 +1,7 @@
 #include "poker.hpp"
 #include <algorithm>
 #include <assert.h>
+#include <bit>
 #include <string>
 #include <stdio.h>
 
@@ -12,17 +13,44 @@
 #include "macros.hpp"
 
 #include "Random/Random.hpp"
+#include "Preflop.hpp"
+#include "Hand_Log.hpp"
 
-std::vector<size_t> pick_winners(
-	const std::array<Player, 3>& players, std::array<Card, 5> board
+// Fills winners with the indices of the best players and returns how many there are.
+size_t pick_winners(
+	const std::array<Player, 3>& players, std::array<Card, 5> board, std::array<size_t, 3>& winners
 ) noexcept;
 
 Game::Game() noexcept {
 	for (size_t i = 0; i < agents.size(); ++i) {
 		agents[i].me = &players[i];
 		players[i].agent = &agents[i];
-		players[i].stack = 500;
 	}
+
+	reset();
+	seed((uint64_t)time(nullptr));
+}
+
+void Game::reset() noexcept {
+	history.clear();
+	current_hand = {};
+	// The order of the deck is part of the random state, start back from a sorted one.
+	deck = {};
+
+	for (auto& x : players) {
+		x.stack = starting_stack;
+		x.bet = 0;
+		x.current_bet = 0;
+		x.folded = false;
+	}
+
+	big_bling_idx = 0;
+	running_bet = 0;
+	raised_turn = false;
+}
+
+void Game::seed(uint64_t seed, uint64_t stream) noexcept {
+	rng = pcg32_seed(seed, stream);
 }
 
 bool Game::over() noexcept {
@@ -57,20 +85,23 @@ void Game::play_game() noexcept {
 
 void Game::play_new_hand() noexcept {
 	current_hand = {};
+	current_record = {};
+	deck.reset();
 
-	for (auto& x : players) {
+	for (size_t j = 0; j < players.size(); ++j) {
+		auto& x = players[j];
 		x.bet = 0;
 		x.current_bet = 0;
 		x.folded = false;
 
 		for (size_t i = 0; i < x.hand.size(); ++i) {
-			auto select = rand() % current_hand.draw.size();
-			x.hand[i] = current_hand.draw[select];
-			current_hand.draw.erase(BEG(current_hand.draw) + select);
+			x.hand[i] = deck.draw(rng);
+			current_record.holes[j * 2 + i] = (uint8_t)CardSet::index(x.hand[i]);
 		}
 	}
 
 	big_bling_idx %= players.size();
+	current_record.big_blind_idx = (uint8_t)big_bling_idx;
 
 	auto& big_blind_player = players[big_bling_idx];
 	auto& small_blind_player = players[((players.size() + big_bling_idx) - 1) % players.size()];
@@ -119,45 +150,57 @@ void Game::play_new_hand() noexcept {
 	round();
 
 	for (size_t i = 0; i < current_hand.flop.size(); ++i) {
-		auto select = rand() % current_hand.draw.size();
-		current_hand.flop[i] = current_hand.draw[select];
-		current_hand.draw.erase(BEG(current_hand.draw) + select);
+		current_hand.flop[i] = deck.draw(rng);
 	}
+	current_hand.n_board = 3;
 
 	round();
 
-	auto select = rand() % current_hand.draw.size();
-	current_hand.turn = current_hand.draw[select];
-	current_hand.draw.erase(BEG(current_hand.draw) + select);
+	current_hand.turn = deck.draw(rng);
+	current_hand.n_board = 4;
 
 	round();
 
-	select = rand() % current_hand.draw.size();
-	current_hand.river = current_hand.draw[select];
-	current_hand.draw.erase(BEG(current_hand.draw) + select);
+	current_hand.river = deck.draw(rng);
+	current_hand.n_board = 5;
 
 	round();
 
-	auto winners = pick_winners(players, {
+	std::array<size_t, 3> winners;
+	size_t n_winners = pick_winners(players, {
 		current_hand.flop[0],
 		current_hand.flop[1],
 		current_hand.flop[2],
 		current_hand.turn,
 		current_hand.river
-	});
+	}, winners);
 
-	for (auto& x : winners) {
+	for (size_t i = 0; i < n_winners; ++i) {
+		auto x = winners[i];
 		auto& p = players[x];
-		p.stack += current_hand.pot / winners.size();
+		p.stack += current_hand.pot / n_winners;
+		current_record.winners |= 1 << x;
 		if (verbose) printf("Joueur %zu (%s) a gagne.\n", x, players[x].name.c_str());
 	}
 
 	big_bling_idx++;
 
-	passed_hands.push_back(current_hand);
+	current_record.board = {
+		(uint8_t)CardSet::index(current_hand.flop[0]),
+		(uint8_t)CardSet::index(current_hand.flop[1]),
+		(uint8_t)CardSet::index(current_hand.flop[2]),
+		(uint8_t)CardSet::index(current_hand.turn),
+		(uint8_t)CardSet::index(current_hand.river)
+	};
+	current_record.pot = (uint32_t)current_hand.pot;
+	history.push(current_record);
+	// A log in error is dropped, its owner sees it when closing it.
+	if (log && !log->write(current_record)) log = nullptr;
 }
 
 void Game::apply(Player& player, Action action) noexcept {
+	current_record.push_action(&player - players.data(), action);
+
 	switch (action.kind) {
 	case Action::Check: break;
 	case Action::Fold: {
@@ -218,6 +261,16 @@ Action Agent::act(const Game& game) noexcept {
 			}
 		}
 
+		// A table that never loaded has nothing to read.
+		if (can_raise && preflop && preflop->loaded() && game.current_hand.n_board == 0) {
+			size_t n_opponents = 0;
+			for (auto& x : game.players) if (me != &x && !x.folded) n_opponents++;
+
+			if (n_opponents && preflop->strength(me->hand, n_opponents) < 1.f / (n_opponents + 1)) {
+				can_raise = false;
+			}
+		}
+
 		if (can_raise) {
 			action.kind = Action::Raise;
 			action.value = to_raise;
@@ -246,269 +299,150 @@ std::string Action::stringify() noexcept {
 
 
 Deck::Deck() noexcept {
-	reserve((size_t)Color::Size * (size_t)Value::Size);
-	for (size_t i = 0; i < (size_t)Color::Size; ++i) {
-		for (size_t j = 0; j < (size_t)Value::Size; ++j) {
-			push_back({ (Color)i, (Value)j });
-		}
-	}
-
-	seed = (size_t)time(nullptr);
-
-	std::default_random_engine rng(seed);
+	for (size_t i = 0; i < cards.size(); ++i) cards[i] = CardSet::card(i);
+}
 
-	shuffle<Card>(data(), size());
-	//std::shuffle(BEG_END(*this), rng);
+Card Deck::draw(pcg32_random_t& rng) noexcept {
+	assert(dealt < cards.size());
+	size_t select = dealt + random(rng, (uint32_t)size());
+	std::swap(cards[dealt], cards[select]);
+	return cards[dealt++];
 }
 
-std::vector<size_t> pick_winners(
-	const std::array<Player, 3>& players, std::array<Card, 5> board
-) noexcept {
-	struct Combo {
-		enum Kind {
-			High = 0,
-			Pair,
-			Two_Pair,
-			Three_Of_A_Kind,
-			Straight,
-			Flush,
-			Full,
-			Four_Of_A_Kind,
-			Straight_Flush,
-			Royal_Flush,
-			Size
-		} kind{ High };
-
-		std::array<Card, 5> cards;
-		size_t player_idx;
-
-		bool operator==(const Combo& other) const noexcept {
-			if (kind != other.kind) return false;
-			for (size_t i = 0; i < cards.size(); ++i) {
-				if (cards[i].value != other.cards[i].value) return false;
+namespace {
+	constexpr size_t N_Values = (size_t)Value::Size;
+
+	// Everything the evaluator needs to know about a 13 bits mask of values.
+	struct Value_Tables {
+		// 1 + highest value of the best straight in the mask, 0 if there is none.
+		std::array<uint8_t, 1 << N_Values> straight{};
+		// Rank of the mask among the masks with the same number of bits, in increasing order.
+		// For masks with the same number of bits the numeric order is the kicker order.
+		std::array<uint16_t, 1 << N_Values> ordinal{};
+		// The mask with only its 5 highest bits.
+		std::array<uint16_t, 1 << N_Values> top5{};
+
+		Value_Tables() noexcept {
+			std::array<uint16_t, N_Values + 1> counts{};
+
+			for (size_t mask = 0; mask < (1 << N_Values); ++mask) {
+				ordinal[mask] = counts[std::popcount(mask)]++;
+
+				uint16_t top = (uint16_t)mask;
+				while (std::popcount(top) > 5) top &= top - 1;
+				top5[mask] = top;
+
+				for (size_t high = (size_t)Value::As; high >= (size_t)Value::Six; --high) {
+					size_t straight_mask = 0b11111ull << (high - 4);
+					if ((mask & straight_mask) == straight_mask) {
+						straight[mask] = (uint8_t)(high + 1);
+						break;
+					}
+				}
+
+				// The wheel: As, Two, Three, Four, Five.
+				size_t wheel = (1 << (size_t)Value::As) | 0b1111;
+				if (!straight[mask] && (mask & wheel) == wheel) {
+					straight[mask] = (uint8_t)Value::Five + 1;
+				}
 			}
-			return true;
-		}
-		bool operator<(const Combo& other) const noexcept {
-			if (kind < other.kind) return true;
-			if (kind > other.kind) return false;
-			if (cards < other.cards) return true;
-			return false;
-		}
-		bool operator>(const Combo& other) const noexcept {
-			if (kind > other.kind) return true;
-			if (kind < other.kind) return false;
-			if (cards > other.cards) return true;
-			return false;
 		}
 	};
 
-#define E END(hand)
-#define X BEG_END(hand)
-	auto get_dominant_color = [](const std::array<Card, 7>& hand) -> std::pair<Color, size_t> {
-		std::array<size_t, (size_t)Color::Size> n{};
-		Color dominant{ Color::Club };
+	const Value_Tables value_tables;
 
-		for (size_t i = 0; i < 4; ++i) ++n[i];
-		for (size_t i = 0; i < n.size(); ++i) if (n[(size_t)dominant] < n[i]) dominant = (Color)i;
-
-		return { dominant, n[(size_t)dominant] };
-	};
-
-	auto test_four_of_a_kind = [&](const std::array<Card, 7> & hand) -> bool {
-		for (size_t i = 0; i < 4; ++i) {
-			bool flag =
-				std::find(X, Card{ Color::Club, hand[i].value }) != E &&
-				std::find(X, Card{ Color::Diamond, hand[i].value }) != E &&
-				std::find(X, Card{ Color::Heart, hand[i].value }) != E &&
-				std::find(X, Card{ Color::Spade, hand[i].value }) != E;
-			if (flag) return true;
-		}
-		return false;
-	};
-
-	auto test_three_of_a_kind = [&](const std::array<Card, 7> & hand) -> bool {
-		for (size_t i = 0; i < 5; ++i) {
-			size_t n =
-				std::count(X, Card{ Color::Club, hand[i].value }) +
-				std::count(X, Card{ Color::Diamond, hand[i].value }) +
-				std::count(X, Card{ Color::Heart, hand[i].value }) +
-				std::count(X, Card{ Color::Spade, hand[i].value });
-
-			if (n >= 3) return true;
-		}
-		return false;
-	};
-
-	auto test_pair = [&](const std::array<Card, 7> & hand) -> bool {
-		for (size_t i = 0; i < 6; ++i) {
-			size_t n =
-				std::count(X, Card{ Color::Club, hand[i].value }) +
-				std::count(X, Card{ Color::Diamond, hand[i].value }) +
-				std::count(X, Card{ Color::Heart, hand[i].value }) +
-				std::count(X, Card{ Color::Spade, hand[i].value });
-
-			if (n >= 2) return true;
-		}
-		return false;
-	};
+	uint16_t highest(uint16_t mask) noexcept {
+		return (uint16_t)(std::bit_width(mask) - 1);
+	}
 
-	auto test_two_pair = [&](const std::array<Card, 7> & hand) -> bool {
-		size_t n_pair = 0;
+	uint16_t keep_highests(uint16_t mask, size_t n) noexcept {
+		while ((size_t)std::popcount(mask) > n) mask &= mask - 1;
+		return mask;
+	}
 
-		for (size_t i = 0; i < 6; ++i) {
-			size_t n =
-				std::count(X, Card{ Color::Club, hand[i].value }) +
-				std::count(X, Card{ Color::Diamond, hand[i].value }) +
-				std::count(X, Card{ Color::Heart, hand[i].value }) +
-				std::count(X, Card{ Color::Spade, hand[i].value });
+	Combo make_combo(Combo::Kind kind, size_t x) noexcept {
+		Combo combo;
+		combo.strength = (uint16_t)(((size_t)kind << 12) | x);
+		return combo;
+	}
+}
 
-			if (n >= 2) n_pair++;
+Combo Combo::evaluate(const std::array<uint16_t, (size_t)Color::Size>& colors) noexcept {
+	auto& t = value_tables;
 
-			// Every pair is counted twice so we need to go to three pairs to detect a double pair.
-			if (n_pair > 2) return true;
+	for (auto x : colors) if (std::popcount(x) >= 5) {
+		if (auto s = t.straight[x]) {
+			size_t high = s - 1;
+			return make_combo(high == (size_t)Value::As ? Royal_Flush : Straight_Flush, high);
 		}
-		return false;
-	};
-
-	auto test_royal_flush = [&](const std::array<Card, 7>& hand) -> bool {
-		auto [dominant, n] = get_dominant_color(hand);
-		if (n < 5) return false;
-
-		return
-			std::find(X, Card{ dominant, Value::As }) != E &&
-			std::find(X, Card{ dominant, Value::King }) != E &&
-			std::find(X, Card{ dominant, Value::Queen }) != E &&
-			std::find(X, Card{ dominant, Value::Jacket }) != E &&
-			std::find(X, Card{ dominant, Value::Ten }) != E
-		;
-	};
-
-	auto test_straight = [&](const std::array<Card, 7>& hand) -> bool {
-		for (size_t i = 0; i < 7; ++i) {
-			auto any_color = [&](Value value) {
-				return std::find_if(X, [&](auto x) {return x.value == value; }) != E;
-			};
+		return make_combo(Flush, t.ordinal[t.top5[x]]);
+	}
 
-			size_t start_value = (size_t)hand[i].value;
-			if (start_value == (size_t)Value::As) start_value = (size_t)(-1);
-			if (start_value > (size_t)Value::Ten) continue;
+	auto [a, b, c, d] = colors;
+	uint16_t values = a | b | c | d;
+	uint16_t fours = a & b & c & d;
+	uint16_t threes = ((a & b) & (c | d)) | ((c & d) & (a | b));
+	uint16_t pairs = (a & b) | (c & d) | ((a | b) & (c | d));
 
-			for (size_t j = 0; j < 4; ++j) {
-				auto to_search = (Value)((start_value + j + 1) % (size_t)Value::Size);
-				if (!any_color(to_search)) goto up_continue;
-			}
+	if (fours) {
+		auto four = highest(fours);
+		return make_combo(Four_Of_A_Kind, four * N_Values + highest(values & ~(1 << four)));
+	}
 
-			return true;
-			up_continue:
-			;
+	if (threes) {
+		auto three = highest(threes);
+		// Any other value seen at least twice, including a second three of a kind.
+		if (auto rest = pairs & ~(1 << three)) {
+			return make_combo(Full, three * N_Values + highest(rest));
 		}
-		return false;
-	};
-
-	auto test_full = [&](const std::array<Card, 7> & hand) -> bool {
-		size_t n_pair = 0;
-		size_t n_brelan = 0;
+	}
 
+	if (auto s = t.straight[values]) return make_combo(Straight, s - 1);
 
-		for (size_t i = 0; i < 6; ++i) {
-			size_t n =
-				std::count(X, Card{ Color::Club, hand[i].value }) +
-				std::count(X, Card{ Color::Diamond, hand[i].value }) +
-				std::count(X, Card{ Color::Heart, hand[i].value }) +
-				std::count(X, Card{ Color::Spade, hand[i].value });
+	if (threes) {
+		auto three = highest(threes);
+		auto kickers = keep_highests(values & ~(1 << three), 2);
+		return make_combo(Three_Of_A_Kind, three * 78 + t.ordinal[kickers]);
+	}
 
-			if (n == 2) n_pair++;
-			if (n == 3) n_brelan++;
+	if (std::popcount(pairs) >= 2) {
+		auto two_pairs = keep_highests(pairs, 2);
+		return make_combo(Two_Pair, t.ordinal[two_pairs] * N_Values + highest(values & ~two_pairs));
+	}
 
-			if (n_pair && n_brelan) return true;
-		}
+	if (pairs) {
+		auto pair = highest(pairs);
+		auto kickers = keep_highests(values & ~(1 << pair), 3);
+		return make_combo(Pair, pair * 286 + t.ordinal[kickers]);
+	}
 
-		return false;
-	};
+	return make_combo(High, t.ordinal[t.top5[values]]);
+}
 
-	auto test_flush = [&](const std::array<Card, 7> & hand) -> bool {
-		return get_dominant_color(hand).second >= 5;
-	};
+Combo Combo::evaluate(const Card* cards, size_t n) noexcept {
+	return evaluate(CardSet::from(cards, n));
+}
 
-	auto test_straight_flush = [&](const std::array<Card, 7>& hand) -> bool {
-		return test_straight(hand) && test_flush(hand);
-	};
-#undef X
-#undef E
+size_t pick_winners(
+	const std::array<Player, 3>& players, std::array<Card, 5> board, std::array<size_t, 3>& winners
+) noexcept {
+	size_t n_winners = 0;
+	Combo best;
 
-	std::vector<Combo> combos;
+	auto board_set = CardSet::from(board);
 
 	for (size_t i = 0; i < players.size(); ++i) {
-		Combo combo;
-		combo.player_idx = i;
 		auto& p = players[i];
-
 		if (p.folded) continue;
 
-		defer{ combos.push_back(combo); };
-
-		std::array<Card, 7> combined_hand = {
-			p.hand[0],
-			p.hand[1],
-			board[0],
-			board[1],
-			board[2],
-			board[3],
-			board[4]
-		};
-
-		if (test_royal_flush(combined_hand)) {
-			combo.kind = Combo::Kind::Royal_Flush;
-		}
-		else if (test_straight_flush(combined_hand)) {
-			combo.kind = Combo::Kind::Straight_Flush;
-		}
-		else if (test_four_of_a_kind(combined_hand)) {
-			combo.kind = Combo::Kind::Four_Of_A_Kind;
-		}
-		else if (test_four_of_a_kind(combined_hand)) {
-			combo.kind = Combo::Kind::Four_Of_A_Kind;
-		}
-		else if (test_full(combined_hand)) {
-			combo.kind = Combo::Kind::Full;
-		}
-		else if (test_flush(combined_hand)) {
-			combo.kind = Combo::Kind::Flush;
-		}
-		else if (test_straight(combined_hand)) {
-			combo.kind = Combo::Kind::Straight;
+		auto combo = Combo::evaluate(board_set | CardSet::from(p.hand));
+		if (n_winners > 0 && combo < best) continue;
+		if (n_winners == 0 || combo > best) {
+			n_winners = 0;
+			best = combo;
 		}
-		else if (test_three_of_a_kind(combined_hand)) {
-			combo.kind = Combo::Kind::Three_Of_A_Kind;
-		}
-		else if (test_two_pair(combined_hand)) {
-			combo.kind = Combo::Kind::Two_Pair;
-		}
-		else if (test_pair(combined_hand)) {
-			combo.kind = Combo::Kind::Pair;
-		}
-		else {
-			combo.kind = Combo::Kind::High;
-		}
-
-		std::sort(BEG_END(combined_hand), [](auto a, auto b) {
-			if (a.value == Value::As && b.value != Value::As) return true;
-			if (a.value != Value::As && b.value == Value::As) return false;
-			return (size_t)a.value > (size_t)b.value;
-		});
-
-		for (size_t j = 0; j < 5; j++) combo.cards[j] = combined_hand[j];
+		winners[n_winners++] = i;
 	}
 
-	std::sort(BEG_END(combos), [](auto& a, auto& b) { return a > b; });
-
-	std::vector<size_t> winners;
-	winners.push_back(combos.front().player_idx);
-	for (size_t i = 1; i < combos.size(); ++i) {
-		if (!(combos[i] == combos[i - 1])) return winners;
-		winners.push_back(combos[i].player_idx);
-	}
-	return winners;
+	return n_winners;
 }
-
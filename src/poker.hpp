@@ -1,6 +1,12 @@
 #pragma once
 #include <array>
 #include <vector>
+#include <string>
+#include <stdint.h>
+#include <bit>
+#include <algorithm>
+
+#include "Random/Random.hpp"
 
 enum class Color {
 	Spade = 0,
@@ -41,10 +47,134 @@ struct Card {
 	}
 };
 
-struct Deck : public std::vector<Card> {
-	size_t seed;
+// One bit per card, the 13 values of a color are contiguous: bit = color * 13 + value.
+struct CardSet {
+	static constexpr size_t N_Values = (size_t)Value::Size;
+	static constexpr size_t N_Cards = (size_t)Color::Size * N_Values;
+	static constexpr uint64_t Color_Mask = (1ull << N_Values) - 1;
+	// The same value in every color.
+	static constexpr uint64_t Value_Mask =
+		1ull | (1ull << N_Values) | (1ull << (2 * N_Values)) | (1ull << (3 * N_Values));
+
+	uint64_t bits{ 0 };
+
+	static size_t index(Card card) noexcept {
+		return (size_t)card.color * N_Values + (size_t)card.value;
+	}
+	static Card card(size_t index) noexcept {
+		return { (Color)(index / N_Values), (Value)(index % N_Values) };
+	}
+
+	static CardSet full() noexcept { return { (1ull << N_Cards) - 1 }; }
+	static CardSet from(Card card) noexcept { return { 1ull << index(card) }; }
+	static CardSet from(const Card* cards, size_t n) noexcept {
+		CardSet set;
+		for (size_t i = 0; i < n; ++i) set.insert(cards[i]);
+		return set;
+	}
+	template<size_t N>
+	static CardSet from(const std::array<Card, N>& cards) noexcept {
+		return from(cards.data(), N);
+	}
+
+	bool contains(Card card) const noexcept { return bits & from(card).bits; }
+	bool contains(CardSet set) const noexcept { return (bits & set.bits) == set.bits; }
+	void insert(Card card) noexcept { bits |= from(card).bits; }
+	void remove(Card card) noexcept { bits &= ~from(card).bits; }
+
+	size_t size() const noexcept { return std::popcount(bits); }
+	bool empty() const noexcept { return bits == 0; }
+
+	// 13 bits mask of the values present in the color.
+	uint16_t values(Color color) const noexcept {
+		return (uint16_t)((bits >> ((size_t)color * N_Values)) & Color_Mask);
+	}
+	// 13 bits mask of the values present in any color.
+	uint16_t values() const noexcept {
+		return
+			values(Color::Spade) | values(Color::Heart) | values(Color::Diamond) | values(Color::Club);
+	}
+	size_t count(Color color) const noexcept { return std::popcount(values(color)); }
+	size_t count(Value value) const noexcept {
+		return std::popcount(bits & (Value_Mask << (size_t)value));
+	}
+
+	// Removes and returns the card with the lowest index, the set must not be empty.
+	Card pop() noexcept {
+		auto i = std::countr_zero(bits);
+		bits &= bits - 1;
+		return card(i);
+	}
+	// Writes the cards in index order and returns how many were written.
+	size_t to_cards(Card* out) const noexcept {
+		size_t n = 0;
+		for (auto it = *this; !it.empty(); ++n) out[n] = it.pop();
+		return n;
+	}
+
+	CardSet operator|(CardSet other) const noexcept { return { bits | other.bits }; }
+	CardSet operator&(CardSet other) const noexcept { return { bits & other.bits }; }
+	CardSet operator-(CardSet other) const noexcept { return { bits & ~other.bits }; }
+	CardSet& operator|=(CardSet other) noexcept { bits |= other.bits; return *this; }
+	CardSet& operator&=(CardSet other) noexcept { bits &= other.bits; return *this; }
+	CardSet& operator-=(CardSet other) noexcept { bits &= ~other.bits; return *this; }
+	bool operator==(const CardSet& other) const noexcept { return bits == other.bits; }
+};
+
+struct Combo {
+	enum Kind {
+		High = 0,
+		Pair,
+		Two_Pair,
+		Three_Of_A_Kind,
+		Straight,
+		Flush,
+		Full,
+		Four_Of_A_Kind,
+		Straight_Flush,
+		Royal_Flush,
+		Size
+	};
+
+	// The kind is stored in the 4 upper bits, the 12 lower bits order the hands of the same kind.
+	// So two strengths can be compared directly, higher is better.
+	uint16_t strength{ 0 };
+
+	Kind kind() const noexcept { return (Kind)(strength >> 12); }
+
+	bool operator==(const Combo& other) const noexcept { return strength == other.strength; }
+	bool operator<(const Combo& other) const noexcept { return strength < other.strength; }
+	bool operator>(const Combo& other) const noexcept { return strength > other.strength; }
+
+	// Best 5 cards combo out of 5 to 7 cards, with a few table lookups.
+	static Combo evaluate(const Card* cards, size_t n) noexcept;
+	static Combo evaluate(const std::array<Card, 7>& cards) noexcept {
+		return evaluate(cards.data(), cards.size());
+	}
+	// Same thing but with one 13 bits mask of values per color.
+	static Combo evaluate(const std::array<uint16_t, (size_t)Color::Size>& colors) noexcept;
+	static Combo evaluate(CardSet cards) noexcept {
+		return evaluate({
+			cards.values(Color::Spade),
+			cards.values(Color::Heart),
+			cards.values(Color::Diamond),
+			cards.values(Color::Club)
+		});
+	}
+};
+
+// Fixed size deck dealt with a partial Fisher-Yates, the first `dealt` cards are out of the deck.
+struct Deck {
+	std::array<Card, CardSet::N_Cards> cards;
+	size_t dealt{ 0 };
 
 	Deck() noexcept;
+
+	// Every draw is uniform whatever the order of the cards, so there is no need to reorder them.
+	void reset() noexcept { dealt = 0; }
+	size_t size() const noexcept { return cards.size() - dealt; }
+
+	Card draw(pcg32_random_t& rng) noexcept;
 };
 
 struct Agent;
@@ -62,18 +192,18 @@ struct Player {
 };
 
 struct Hand {
-	Deck draw;
-
 	std::array<Card, 3> flop;
 	Card turn;
 	Card river;
+	// How many of the 5 board cards are dealt so far.
+	size_t n_board{ 0 };
 
 	size_t pot{ 0 };
 	size_t big_blind{ 0 };
 };
 
 struct Action {
-	size_t value;
+	size_t value{ 0 };
 	enum {
 		Follow = 0,
 		Raise,
@@ -85,9 +215,79 @@ struct Action {
 
 	std::string stringify() noexcept;
 };
+
+// Fixed width record of a finished hand, cards are stored as CardSet indices.
+struct Hand_Record {
+	// 4 rounds of at most 2 passes of 3 players.
+	static constexpr size_t Max_Actions = 24;
+
+	std::array<uint8_t, 6> holes{};
+	std::array<uint8_t, 5> board{};
+	uint8_t n_actions{ 0 };
+	uint8_t big_blind_idx{ 0 };
+	// One bit per seat sharing the pot.
+	uint8_t winners{ 0 };
+	uint32_t pot{ 0 };
+	// The seat in the 2 lower bits, the kind in the next 3 and the value in the rest.
+	std::array<uint32_t, Max_Actions> actions{};
+
+	void push_action(size_t seat, const Action& action) noexcept {
+		if (n_actions == Max_Actions) return;
+		actions[n_actions++] = (uint32_t)(seat | ((size_t)action.kind << 2) | (action.value << 5));
+	}
+
+	size_t action_seat(size_t i) const noexcept { return actions[i] & 0b11; }
+	Action action(size_t i) const noexcept {
+		Action a;
+		a.kind = (decltype(a.kind))((actions[i] >> 2) & 0b111);
+		a.value = actions[i] >> 5;
+		return a;
+	}
+	Card hole(size_t seat, size_t i) const noexcept { return CardSet::card(holes[seat * 2 + i]); }
+	Card board_card(size_t i) const noexcept { return CardSet::card(board[i]); }
+};
+
+// Ring buffer of the last hands played, the memory stays flat whatever the length of the game.
+struct Hand_History {
+	std::vector<Hand_Record> records;
+	size_t next{ 0 };
+	// Every hand pushed since the last clear, including the overwritten ones.
+	size_t total{ 0 };
+
+	Hand_History(size_t capacity = 256) noexcept { records.resize(capacity); }
+
+	size_t capacity() const noexcept { return records.size(); }
+	size_t size() const noexcept { return std::min(total, capacity()); }
+
+	void set_capacity(size_t capacity) noexcept {
+		records.assign(capacity, {});
+		clear();
+	}
+	void clear() noexcept {
+		next = 0;
+		total = 0;
+	}
+
+	void push(const Hand_Record& record) noexcept {
+		total++;
+		if (records.empty()) return;
+		records[next] = record;
+		next = (next + 1) % capacity();
+	}
+
+	// 0 is the last hand played, up to size() - 1.
+	const Hand_Record& recent(size_t i) const noexcept {
+		return records[(next + 2 * capacity() - 1 - i) % capacity()];
+	}
+};
 struct Game;
+struct Preflop_Table;
+struct Hand_Log_Writer;
 struct Agent {
 	Player* me;
+	// Optional, when set and loaded the agent does not raise preflop with hands below their fair
+	// share.
+	const Preflop_Table* preflop{ nullptr };
 
 	Action act(const Game& game) noexcept;
 };
@@ -95,12 +295,19 @@ struct Agent {
 struct Game {
 	Game() noexcept;
 
-	std::vector<Hand> passed_hands;
+	Hand_History history;
+	// Optional, every finished hand is also appended to it.
+	Hand_Log_Writer* log{ nullptr };
 	Hand current_hand;
+	Hand_Record current_record;
+
+	Deck deck;
+	pcg32_random_t rng;
 
 	std::array<Player, 3> players;
 	std::array<Agent, 3> agents;
 
+	size_t starting_stack{ 500 };
 	size_t big_blind{ 10 };
 	size_t big_bling_idx{ 0 };
 	
@@ -108,6 +315,10 @@ struct Game {
 
 	bool raised_turn{ false };
 
+	void seed(uint64_t seed, uint64_t stream = 0) noexcept;
+	// Back to the starting stacks with no history, keeps the allocated memory.
+	void reset() noexcept;
+
 	void play_game() noexcept;
 	void play_new_hand() noexcept;
 	void apply(Player& player, Action x) noexcept;